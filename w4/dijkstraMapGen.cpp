@@ -1,6 +1,7 @@
 #include "dijkstraMapGen.h"
 #include "ecsTypes.h"
 #include "dungeonUtils.h"
+#include <algorithm>
 
 template<typename Callable>
 static void query_dungeon_data(flecs::world &ecs, Callable c)
@@ -27,13 +28,13 @@ static void init_tiles(std::vector<float> &map, const DungeonData &dd)
     v = invalid_tile_value;
 }
 
-// scan version, could be implemented as Dijkstra version as well
-static void process_dmap(std::vector<float> &map, const DungeonData &dd)
+// scan version, kept as a reference for the queue one
+static void process_dmap_scan(std::vector<float> &map, const DungeonData &dd)
 {
   bool done = false;
   auto getMapAt = [&](size_t x, size_t y, float def)
   {
-    if (x < dd.width && y < dd.width && dd.tiles[y * dd.width + x] == dungeon::floor)
+    if (x < dd.width && y < dd.height && dd.tiles[y * dd.width + x] == dungeon::floor)
       return map[y * dd.width + x];
     return def;
   };
@@ -66,7 +67,68 @@ static void process_dmap(std::vector<float> &map, const DungeonData &dd)
   }
 }
 
-void dmaps::gen_player_approach_map(flecs::world &ecs, std::vector<float> &map)
+// Dijkstra version, all edges cost 1 so instead of a heap we merge sorted seeds with a plain FIFO:
+// every pushed value is popped value + 1, so the FIFO stays sorted and each tile is popped only once
+static void process_dmap_queue(std::vector<float> &map, const DungeonData &dd)
+{
+  std::vector<std::pair<float, size_t>> seeds;
+  for (size_t i = 0; i < map.size(); ++i)
+    if (map[i] < invalid_tile_value)
+      seeds.emplace_back(map[i], i);
+  std::sort(seeds.begin(), seeds.end());
+
+  std::vector<bool> done(map.size(), false);
+  std::vector<size_t> queue;
+  queue.reserve(map.size());
+  size_t head = 0;
+  size_t seedIdx = 0;
+  // same comparison as in scan version, so that float rounding gives identical results
+  auto relax = [&](size_t x, size_t y, float val)
+  {
+    const size_t i = y * dd.width + x;
+    if (x < dd.width && y < dd.height && dd.tiles[i] == dungeon::floor && val < map[i] - 1.f)
+    {
+      map[i] = val + 1.f;
+      queue.push_back(i);
+    }
+  };
+  while (head < queue.size() || seedIdx < seeds.size())
+  {
+    size_t i = 0;
+    if (head == queue.size() || (seedIdx < seeds.size() && seeds[seedIdx].first <= map[queue[head]]))
+    {
+      // seed could've been improved already, then it's in the queue
+      if (seeds[seedIdx].first > map[seeds[seedIdx].second])
+      {
+        seedIdx++;
+        continue;
+      }
+      i = seeds[seedIdx++].second;
+    }
+    else
+      i = queue[head++];
+    if (done[i] || dd.tiles[i] != dungeon::floor)
+      continue;
+    done[i] = true;
+    const size_t x = i % dd.width;
+    const size_t y = i / dd.width;
+    const float val = map[i];
+    relax(x - 1, y + 0, val);
+    relax(x + 1, y + 0, val);
+    relax(x + 0, y - 1, val);
+    relax(x + 0, y + 1, val);
+  }
+}
+
+static void process_dmap(std::vector<float> &map, const DungeonData &dd, dmaps::Backend backend)
+{
+  if (backend == dmaps::Backend::Scan)
+    process_dmap_scan(map, dd);
+  else
+    process_dmap_queue(map, dd);
+}
+
+void dmaps::gen_player_approach_map(flecs::world &ecs, std::vector<float> &map, Backend backend)
 {
   query_dungeon_data(ecs, [&](const DungeonData &dd)
   {
@@ -76,23 +138,23 @@ void dmaps::gen_player_approach_map(flecs::world &ecs, std::vector<float> &map)
       if (t.team == 0) // player team hardcode
         map[pos.y * dd.width + pos.x] = 0.f;
     });
-    process_dmap(map, dd);
+    process_dmap(map, dd, backend);
   });
 }
 
-void dmaps::gen_player_flee_map(flecs::world &ecs, std::vector<float> &map)
+void dmaps::gen_player_flee_map(flecs::world &ecs, std::vector<float> &map, Backend backend)
 {
-  gen_player_approach_map(ecs, map);
+  gen_player_approach_map(ecs, map, backend);
   for (float &v : map)
     if (v < invalid_tile_value)
       v *= -1.2f;
   query_dungeon_data(ecs, [&](const DungeonData &dd)
   {
-    process_dmap(map, dd);
+    process_dmap(map, dd, backend);
   });
 }
 
-void dmaps::gen_hive_pack_map(flecs::world &ecs, std::vector<float> &map)
+void dmaps::gen_hive_pack_map(flecs::world &ecs, std::vector<float> &map, Backend backend)
 {
   static auto hiveQuery = ecs.query<const Position, const Hive>();
   query_dungeon_data(ecs, [&](const DungeonData &dd)
@@ -102,7 +164,7 @@ void dmaps::gen_hive_pack_map(flecs::world &ecs, std::vector<float> &map)
     {
       map[pos.y * dd.width + pos.x] = 0.f;
     });
-    process_dmap(map, dd);
+    process_dmap(map, dd, backend);
   });
 }
 
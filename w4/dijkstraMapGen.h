@@ -4,8 +4,14 @@
 
 namespace dmaps
 {
-  void gen_player_approach_map(flecs::world &ecs, std::vector<float> &map);
-  void gen_player_flee_map(flecs::world &ecs, std::vector<float> &map);
-  void gen_hive_pack_map(flecs::world &ecs, std::vector<float> &map);
+  enum class Backend
+  {
+    Scan,
+    Queue
+  };
+
+  void gen_player_approach_map(flecs::world &ecs, std::vector<float> &map, Backend backend = Backend::Queue);
+  void gen_player_flee_map(flecs::world &ecs, std::vector<float> &map, Backend backend = Backend::Queue);
+  void gen_hive_pack_map(flecs::world &ecs, std::vector<float> &map, Backend backend = Backend::Queue);
 };
 
@@ -2,9 +2,32 @@
 #include "raylib.h"
 #include <flecs.h>
 #include <algorithm>
+#include <cstdio>
 #include "ecsTypes.h"
 #include "roguelike.h"
 #include "dungeonGen.h"
+#include "dijkstraMapGen.h"
+
+static void debug_dmap_generators(flecs::world &ecs)
+{
+  using GenFunc = void (*)(flecs::world &, std::vector<float> &, dmaps::Backend);
+  const std::pair<const char *, GenFunc> generators[] = {
+    {"approach_map", dmaps::gen_player_approach_map},
+    {"flee_map", dmaps::gen_player_flee_map},
+    {"hive_map", dmaps::gen_hive_pack_map}};
+  for (const auto &gen : generators)
+  {
+    std::vector<float> scanMap;
+    std::vector<float> queueMap;
+    gen.second(ecs, scanMap, dmaps::Backend::Scan);
+    gen.second(ecs, queueMap, dmaps::Backend::Queue);
+    size_t mismatches = scanMap.size() == queueMap.size() ? 0 : scanMap.size();
+    for (size_t i = 0; i < std::min(scanMap.size(), queueMap.size()); ++i)
+      if (scanMap[i] != queueMap[i])
+        mismatches++;
+    printf("%s: %zu mismatches between scan and queue versions\n", gen.first, mismatches);
+  }
+}
 
 static void update_camera(Camera2D &cam, flecs::world &ecs)
 {
@@ -41,6 +64,7 @@ int main(int /*argc*/, const char ** /*argv*/)
     init_dungeon(ecs, tiles, dungWidth, dungHeight);
   }
   init_roguelike(ecs);
+  //debug_dmap_generators(ecs);
 
   Camera2D camera = { {0, 0}, {0, 0}, 0.f, 1.f };
   camera.target = Vector2{ 0.f, 0.f };
@@ -1,6 +1,12 @@
 #include "dijkstraMapGen.h"
 #include "ecsTypes.h"
 #include "dungeonUtils.h"
+#include "dmapSweep.h"
+#include "dmapHierarchy.h"
+#include "dmapQuantize.h"
+#include <algorithm>
+#include <bit>
+#include <queue>
 
 template<typename Callable>
 static void query_dungeon_data(flecs::world &ecs, Callable c)
@@ -27,13 +33,13 @@ static void init_tiles(std::vector<float> &map, const DungeonData &dd)
     v = invalid_tile_value;
 }
 
-// scan version, could be implemented as Dijkstra version as well
-static void process_dmap(std::vector<float> &map, const DungeonData &dd)
+// scan version, kept as a reference for the queue one
+static void process_dmap_scan(std::vector<float> &map, const DungeonData &dd)
 {
   bool done = false;
   auto getMapAt = [&](size_t x, size_t y, float def)
   {
-    if (x < dd.width && y < dd.width && dd.tiles[y * dd.width + x] == dungeon::floor)
+    if (x < dd.width && y < dd.height && dd.tiles[y * dd.width + x] == dungeon::floor)
       return map[y * dd.width + x];
     return def;
   };
@@ -66,7 +72,154 @@ static void process_dmap(std::vector<float> &map, const DungeonData &dd)
   }
 }
 
-void dmaps::gen_player_approach_map(flecs::world &ecs, std::vector<float> &map)
+// Dijkstra version, all edges cost 1 so instead of a heap we merge sorted seeds with a plain FIFO:
+// every pushed value is popped value + 1, so the FIFO stays sorted and each tile is popped only once
+static void process_dmap_queue(std::vector<float> &map, const DungeonData &dd)
+{
+  std::vector<std::pair<float, size_t>> seeds;
+  for (size_t i = 0; i < map.size(); ++i)
+    if (map[i] < invalid_tile_value)
+      seeds.emplace_back(map[i], i);
+  std::sort(seeds.begin(), seeds.end());
+
+  std::vector<bool> done(map.size(), false);
+  std::vector<size_t> queue;
+  queue.reserve(map.size());
+  size_t head = 0;
+  size_t seedIdx = 0;
+  // same comparison as in scan version, so that float rounding gives identical results
+  auto relax = [&](size_t x, size_t y, float val)
+  {
+    const size_t i = y * dd.width + x;
+    if (x < dd.width && y < dd.height && dd.tiles[i] == dungeon::floor && val < map[i] - 1.f)
+    {
+      map[i] = val + 1.f;
+      queue.push_back(i);
+    }
+  };
+  while (head < queue.size() || seedIdx < seeds.size())
+  {
+    size_t i = 0;
+    if (head == queue.size() || (seedIdx < seeds.size() && seeds[seedIdx].first <= map[queue[head]]))
+    {
+      // seed could've been improved already, then it's in the queue
+      if (seeds[seedIdx].first > map[seeds[seedIdx].second])
+      {
+        seedIdx++;
+        continue;
+      }
+      i = seeds[seedIdx++].second;
+    }
+    else
+      i = queue[head++];
+    if (done[i] || dd.tiles[i] != dungeon::floor)
+      continue;
+    done[i] = true;
+    const size_t x = i % dd.width;
+    const size_t y = i / dd.width;
+    const float val = map[i];
+    relax(x - 1, y + 0, val);
+    relax(x + 1, y + 0, val);
+    relax(x + 0, y - 1, val);
+    relax(x + 0, y + 1, val);
+  }
+}
+
+static void process_dmap(std::vector<float> &map, const DungeonData &dd, dmaps::Backend backend)
+{
+  if (backend == dmaps::Backend::Scan)
+    process_dmap_scan(map, dd);
+  else if (backend == dmaps::Backend::Sweep)
+    dmaps::sweep_dmap(map, dd, invalid_tile_value);
+  else
+    process_dmap_queue(map, dd);
+}
+
+void dmaps::gen_map(std::vector<float> &map, const DungeonData &dd, const std::vector<Seed> &seeds, Backend backend)
+{
+  init_tiles(map, dd);
+  for (const Seed &seed : seeds)
+    map[seed.tile] = std::min(map[seed.tile], seed.value);
+  process_dmap(map, dd, backend);
+}
+
+static float &sparse_tile(DijkstraMapData &map, size_t x, size_t y)
+{
+  constexpr size_t chunkSize = DijkstraMapData::chunk_size;
+  const size_t chunksX = (map.width + chunkSize - 1) / chunkSize;
+  uint32_t &chunk = map.chunks[(y / chunkSize) * chunksX + x / chunkSize];
+  if (chunk == DijkstraMapData::no_chunk)
+  {
+    chunk = uint32_t(map.chunkValues.size() / (chunkSize * chunkSize));
+    map.chunkValues.resize(map.chunkValues.size() + chunkSize * chunkSize, map.defaultValue);
+  }
+  return map.chunkValues[chunk * chunkSize * chunkSize + (y % chunkSize) * chunkSize + x % chunkSize];
+}
+
+// same seeds + FIFO merge as the queue version, but every entry also carries the distance to its seed
+void dmaps::gen_bounded_map(DijkstraMapData &map, const DungeonData &dd, const std::vector<Seed> &seeds, float max_radius)
+{
+  constexpr size_t chunkSize = DijkstraMapData::chunk_size;
+  map.storage = DijkstraMapData::Storage::Sparse;
+  map.width = dd.width;
+  map.height = dd.height;
+  map.defaultValue = invalid_tile_value;
+  map.chunks.assign(((dd.width + chunkSize - 1) / chunkSize) * ((dd.height + chunkSize - 1) / chunkSize),
+                    DijkstraMapData::no_chunk);
+  map.chunkValues.clear();
+  map.chunkDefaults.clear();
+
+  std::vector<std::pair<float, size_t>> sortedSeeds;
+  for (const Seed &seed : seeds)
+  {
+    float &val = sparse_tile(map, seed.tile % dd.width, seed.tile / dd.width);
+    val = std::min(val, seed.value);
+    sortedSeeds.emplace_back(seed.value, seed.tile);
+  }
+  std::sort(sortedSeeds.begin(), sortedSeeds.end());
+
+  struct Entry
+  {
+    size_t tile;
+    float value;
+    float dist;
+  };
+  std::vector<Entry> queue;
+  size_t head = 0;
+  size_t seedIdx = 0;
+  auto relax = [&](size_t x, size_t y, float val, float dist)
+  {
+    const size_t i = y * dd.width + x;
+    if (x < dd.width && y < dd.height && dd.tiles[i] == dungeon::floor && dist + 1.f <= max_radius &&
+        val < map.at(i) - 1.f)
+    {
+      sparse_tile(map, x, y) = val + 1.f;
+      queue.push_back({i, val + 1.f, dist + 1.f});
+    }
+  };
+  while (head < queue.size() || seedIdx < sortedSeeds.size())
+  {
+    Entry cur;
+    if (head == queue.size() || (seedIdx < sortedSeeds.size() && sortedSeeds[seedIdx].first <= queue[head].value))
+    {
+      cur = {sortedSeeds[seedIdx].second, sortedSeeds[seedIdx].first, 0.f};
+      seedIdx++;
+    }
+    else
+      cur = queue[head++];
+    // entry is outdated if the tile was improved after it had been pushed
+    if (cur.value != map.at(cur.tile) || dd.tiles[cur.tile] != dungeon::floor)
+      continue;
+    const size_t x = cur.tile % dd.width;
+    const size_t y = cur.tile / dd.width;
+    relax(x - 1, y + 0, cur.value, cur.dist);
+    relax(x + 1, y + 0, cur.value, cur.dist);
+    relax(x + 0, y - 1, cur.value, cur.dist);
+    relax(x + 0, y + 1, cur.value, cur.dist);
+  }
+}
+
+void dmaps::gen_player_approach_map(flecs::world &ecs, std::vector<float> &map, Backend backend)
 {
   query_dungeon_data(ecs, [&](const DungeonData &dd)
   {
@@ -76,23 +229,50 @@ void dmaps::gen_player_approach_map(flecs::world &ecs, std::vector<float> &map)
       if (t.team == 0) // player team hardcode
         map[pos.y * dd.width + pos.x] = 0.f;
     });
-    process_dmap(map, dd);
+    process_dmap(map, dd, backend);
   });
 }
 
-void dmaps::gen_player_flee_map(flecs::world &ecs, std::vector<float> &map)
+static float flee_seed(float approach_value, const dmaps::FleeParams &params)
+{
+  if (approach_value >= invalid_tile_value)
+    return invalid_tile_value;
+  return std::min(approach_value, params.maxRadius) * params.coefficient;
+}
+
+void dmaps::gen_flee_map(std::vector<float> &map, const DungeonData &dd, const std::vector<float> &approach,
+                         const FleeParams &params)
 {
-  gen_player_approach_map(ecs, map);
+  init_tiles(map, dd);
+  for (size_t i = 0; i < approach.size(); ++i)
+    map[i] = flee_seed(approach[i], params);
+  // every tile is a seed here, the sorted seeds merge in queue version already is a single Dijkstra pass
+  process_dmap_queue(map, dd);
+}
+
+void dmaps::gen_player_flee_map(flecs::world &ecs, std::vector<float> &map, Backend backend)
+{
+  if (backend != Backend::Scan)
+  {
+    std::vector<float> approach;
+    gen_player_approach_map(ecs, approach, backend);
+    query_dungeon_data(ecs, [&](const DungeonData &dd)
+    {
+      gen_flee_map(map, dd, approach);
+    });
+    return;
+  }
+  gen_player_approach_map(ecs, map, backend);
   for (float &v : map)
     if (v < invalid_tile_value)
       v *= -1.2f;
   query_dungeon_data(ecs, [&](const DungeonData &dd)
   {
-    process_dmap(map, dd);
+    process_dmap(map, dd, backend);
   });
 }
 
-void dmaps::gen_hive_pack_map(flecs::world &ecs, std::vector<float> &map)
+void dmaps::gen_hive_pack_map(flecs::world &ecs, std::vector<float> &map, Backend backend)
 {
   static auto hiveQuery = ecs.query<const Position, const Hive>();
   query_dungeon_data(ecs, [&](const DungeonData &dd)
@@ -102,7 +282,326 @@ void dmaps::gen_hive_pack_map(flecs::world &ecs, std::vector<float> &map)
     {
       map[pos.y * dd.width + pos.x] = 0.f;
     });
-    process_dmap(map, dd);
+    process_dmap(map, dd, backend);
   });
 }
 
+
+// Dynamic repair of a map whose seeds changed. Raised seeds first invalidate every tile that could've
+// got its value through them (value == neighbour + 1), then invalidated tiles are reseeded from
+// their valid neighbours and all decreases are propagated with a Dijkstra, so the work is proportional
+// to the area that actually changes.
+static void repair_dmap(std::vector<float> &map, dmaps::SeedState &state, const DungeonData &dd,
+                        const std::vector<dmaps::Seed> &changes)
+{
+  constexpr uint8_t touchedMark = 1;
+  constexpr uint8_t invalidMark = 2;
+  std::vector<uint8_t> &marks = state.marks;
+  std::vector<std::pair<size_t, float>> touched; // tile and its value before repair
+  auto touch = [&](size_t i)
+  {
+    if (marks[i] & touchedMark)
+      return;
+    marks[i] |= touchedMark;
+    touched.emplace_back(i, map[i]);
+  };
+  auto isFloor = [&](size_t x, size_t y)
+  {
+    return x < dd.width && y < dd.height && dd.tiles[y * dd.width + x] == dungeon::floor;
+  };
+  auto forEachNeighbour = [&](size_t i, auto c)
+  {
+    const size_t x = i % dd.width;
+    const size_t y = i / dd.width;
+    if (isFloor(x - 1, y + 0)) c(i - 1);
+    if (isFloor(x + 1, y + 0)) c(i + 1);
+    if (isFloor(x + 0, y - 1)) c(i - dd.width);
+    if (isFloor(x + 0, y + 1)) c(i + dd.width);
+  };
+
+  using OpenEntry = std::pair<float, size_t>;
+  std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry>> openList;
+  std::vector<size_t> raised;
+  for (const dmaps::Seed &seed : changes)
+  {
+    const float oldSeed = state.seeds[seed.tile];
+    state.seeds[seed.tile] = seed.value;
+    touch(seed.tile);
+    if (dd.tiles[seed.tile] != dungeon::floor) // seeds on walls don't propagate, same as in generation
+      map[seed.tile] = seed.value;
+    else if (seed.value < map[seed.tile])
+    {
+      map[seed.tile] = seed.value;
+      openList.push({seed.value, seed.tile});
+    }
+    else if (seed.value > oldSeed && oldSeed == map[seed.tile])
+      raised.push_back(seed.tile);
+  }
+
+  // increase phase, invalidate everything that depended on raised tiles
+  auto invalidated = [&](size_t i) { return (marks[i] & invalidMark) != 0; };
+  std::vector<size_t> invalid;
+  for (size_t i : raised)
+    if (!invalidated(i))
+    {
+      marks[i] |= invalidMark;
+      invalid.push_back(i);
+    }
+  for (size_t head = 0; head < invalid.size(); ++head)
+  {
+    const size_t i = invalid[head];
+    const float val = map[i];
+    map[i] = invalid_tile_value;
+    forEachNeighbour(i, [&](size_t n)
+    {
+      if (invalidated(n) || map[n] >= invalid_tile_value || map[n] != val + 1.f || state.seeds[n] == map[n])
+        return;
+      touch(n);
+      marks[n] |= invalidMark;
+      invalid.push_back(n);
+    });
+  }
+  for (size_t i : invalid)
+  {
+    float val = state.seeds[i];
+    forEachNeighbour(i, [&](size_t n)
+    {
+      if (!invalidated(n) && map[n] < val - 1.f)
+        val = map[n] + 1.f;
+    });
+    if (val < invalid_tile_value)
+    {
+      map[i] = val;
+      openList.push({val, i});
+    }
+  }
+
+  // decrease phase
+  while (!openList.empty())
+  {
+    const auto [val, i] = openList.top();
+    openList.pop();
+    if (val != map[i])
+      continue;
+    forEachNeighbour(i, [&](size_t n)
+    {
+      if (val < map[n] - 1.f)
+      {
+        touch(n);
+        map[n] = val + 1.f;
+        openList.push({map[n], n});
+      }
+    });
+  }
+
+  state.changed.clear();
+  for (const auto &[i, oldVal] : touched)
+  {
+    marks[i] = 0;
+    if (map[i] != oldVal)
+      state.changed.push_back(i);
+  }
+}
+
+static bool init_seed_state(std::vector<float> &map, dmaps::SeedState &state, const DungeonData &dd)
+{
+  if (map.size() == dd.width * dd.height && state.seeds.size() == map.size())
+    return false;
+  init_tiles(map, dd);
+  state.seeds.assign(map.size(), invalid_tile_value);
+  state.seedTiles.clear();
+  state.marks.assign(map.size(), 0);
+  return true;
+}
+
+void dmaps::set_seeds(std::vector<float> &map, SeedState &state, const DungeonData &dd, std::vector<Seed> seeds)
+{
+  std::sort(seeds.begin(), seeds.end(), [](const Seed &a, const Seed &b)
+  {
+    return a.tile < b.tile || (a.tile == b.tile && a.value < b.value);
+  });
+  // several seeds on one tile, lowest wins
+  seeds.erase(std::unique(seeds.begin(), seeds.end(), [](const Seed &a, const Seed &b) { return a.tile == b.tile; }),
+              seeds.end());
+
+  if (init_seed_state(map, state, dd))
+  {
+    // nothing to repair, generate from scratch
+    for (const Seed &seed : seeds)
+    {
+      state.seeds[seed.tile] = seed.value;
+      state.seedTiles.push_back(seed.tile);
+      map[seed.tile] = seed.value;
+    }
+    process_dmap(map, dd, state.backend);
+    state.changed.resize(map.size());
+    for (size_t i = 0; i < map.size(); ++i)
+      state.changed[i] = i;
+    return;
+  }
+
+  std::vector<Seed> changes;
+  auto oldIt = state.seedTiles.begin();
+  for (const Seed &seed : seeds)
+  {
+    for (; oldIt != state.seedTiles.end() && *oldIt < seed.tile; ++oldIt)
+      changes.push_back({*oldIt, invalid_tile_value});
+    if (oldIt != state.seedTiles.end() && *oldIt == seed.tile)
+      ++oldIt;
+    if (state.seeds[seed.tile] != seed.value)
+      changes.push_back(seed);
+  }
+  for (; oldIt != state.seedTiles.end(); ++oldIt)
+    changes.push_back({*oldIt, invalid_tile_value});
+
+  state.seedTiles.clear();
+  for (const Seed &seed : seeds)
+    state.seedTiles.push_back(seed.tile);
+  repair_dmap(map, state, dd, changes);
+}
+
+void dmaps::update_seeds(std::vector<float> &map, SeedState &state, const DungeonData &dd, const std::vector<Seed> &seeds)
+{
+  if (init_seed_state(map, state, dd))
+  {
+    set_seeds(map, state, dd, seeds);
+    return;
+  }
+  std::vector<Seed> changes;
+  for (const Seed &seed : seeds)
+    if (state.seeds[seed.tile] != seed.value)
+      changes.push_back(seed);
+  for (const Seed &seed : changes)
+  {
+    auto itf = std::lower_bound(state.seedTiles.begin(), state.seedTiles.end(), seed.tile);
+    const bool present = itf != state.seedTiles.end() && *itf == seed.tile;
+    if (seed.value < invalid_tile_value && !present)
+      state.seedTiles.insert(itf, seed.tile);
+    else if (seed.value >= invalid_tile_value && present)
+      state.seedTiles.erase(itf);
+  }
+  repair_dmap(map, state, dd, changes);
+}
+
+std::vector<dmaps::Seed> dmaps::gather_player_seeds(flecs::world &ecs, const DungeonData &dd)
+{
+  std::vector<Seed> seeds;
+  query_characters_positions(ecs, [&](const Position &pos, const Team &t)
+  {
+    if (t.team == 0) // player team hardcode
+      seeds.push_back({size_t(pos.y) * dd.width + size_t(pos.x), 0.f});
+  });
+  return seeds;
+}
+
+std::vector<dmaps::Seed> dmaps::gather_hive_seeds(flecs::world &ecs, const DungeonData &dd)
+{
+  static auto hiveQuery = ecs.query<const Position, const Hive>();
+  std::vector<Seed> seeds;
+  hiveQuery.each([&](const Position &pos, const Hive &)
+  {
+    seeds.push_back({size_t(pos.y) * dd.width + size_t(pos.x), 0.f});
+  });
+  return seeds;
+}
+
+static uint64_t mix_hash(uint64_t x)
+{
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+// seeds come in query order, so they're hashed separately and summed up
+static uint64_t hash_seeds(const std::vector<dmaps::Seed> &seeds, const DungeonData &dd)
+{
+  uint64_t res = mix_hash(dd.version) + mix_hash(seeds.size());
+  for (const dmaps::Seed &seed : seeds)
+    res += mix_hash(uint64_t(seed.tile) << 32 ^ std::bit_cast<uint32_t>(seed.value));
+  return res;
+}
+
+// returns false if inputs are the same as in the last update, so there's nothing to do
+static bool start_update(dmaps::MapBuffer &buf, const DungeonData &dd, uint64_t input_hash)
+{
+  const bool built = is_sparse(buf) || !buf.map.empty();
+  if (buf.dungeonVersion != dd.version)
+  {
+    // repairs can't handle changed walls, start over
+    buf.map.clear();
+    buf.dungeonVersion = dd.version;
+  }
+  else if (built && buf.inputHash == input_hash)
+  {
+    buf.state.changed.clear();
+    buf.upToDate = true;
+    buf.skippedUpdates++;
+    return false;
+  }
+  buf.inputHash = input_hash;
+  buf.upToDate = false;
+  buf.updates++;
+  return true;
+}
+
+bool dmaps::is_sparse(const MapBuffer &buf)
+{
+  return buf.fineRadius > 0 || buf.maxRadius < std::numeric_limits<float>::infinity();
+}
+
+void dmaps::upd_map(MapBuffer &buf, const DungeonData &dd, const std::vector<Seed> &seeds,
+                    const CoarseGraph *graph, const std::vector<size_t> &consumers)
+{
+  uint64_t inputHash = hash_seeds(seeds, dd);
+  if (buf.fineRadius > 0)
+    for (size_t consumer : consumers)
+      inputHash += mix_hash(consumer ^ buf.fineRadius << 32);
+  if (!start_update(buf, dd, inputHash))
+    return;
+  if (buf.fineRadius > 0)
+    gen_hierarchical_map(buf.sparse, *graph, dd, seeds, consumers, buf.fineRadius);
+  else if (buf.maxRadius < std::numeric_limits<float>::infinity())
+    gen_bounded_map(buf.sparse, dd, seeds, buf.maxRadius);
+  else
+    set_seeds(buf.map, buf.state, dd, seeds);
+}
+
+void dmaps::upd_player_flee_map(MapBuffer &buf, const DungeonData &dd, const MapBuffer &approach,
+                                const FleeParams &params)
+{
+  const uint64_t paramsHash = mix_hash(uint64_t(std::bit_cast<uint32_t>(params.coefficient)) << 32 ^
+                                       std::bit_cast<uint32_t>(params.maxRadius));
+  if (!start_update(buf, dd, mix_hash(approach.inputHash) + paramsHash))
+    return;
+  // every reachable tile seeds the flee map, so only tiles changed in approach map change seeds here
+  std::vector<Seed> seeds;
+  if (buf.map.empty() || paramsHash != buf.paramsHash)
+  {
+    // fresh buffer can't rely on changes, approach map might've been built without it
+    buf.map.clear();
+    buf.paramsHash = paramsHash;
+    for (size_t i = 0; i < approach.map.size(); ++i)
+      if (approach.map[i] < invalid_tile_value)
+        seeds.push_back({i, flee_seed(approach.map[i], params)});
+  }
+  else
+    for (size_t i : approach.state.changed)
+      seeds.push_back({i, flee_seed(approach.map[i], params)});
+  update_seeds(buf.map, buf.state, dd, seeds);
+}
+
+void dmaps::publish_map(DijkstraMapData &dmap, MapBuffer &buf)
+{
+  if (is_sparse(buf))
+    dmap = buf.sparse; // copied, a stale map with unchanged inputs is republished without being regenerated
+  else if (dmap.storage == DijkstraMapData::Storage::Fixed)
+    quantize_map(dmap, buf.map, buf.state.changed, buf.stale);
+  else if (buf.stale || dmap.map.size() != buf.map.size())
+    dmap.map = buf.map;
+  else
+    for (size_t i : buf.state.changed)
+      dmap.map[i] = buf.map[i];
+  buf.stale = false;
+}
@@ -1,11 +1,99 @@
 #pragma once
+#include <cstdint>
+#include <limits>
 #include <vector>
 #include <flecs.h>
+#include "ecsTypes.h"
 
 namespace dmaps
 {
-  void gen_player_approach_map(flecs::world &ecs, std::vector<float> &map);
-  void gen_player_flee_map(flecs::world &ecs, std::vector<float> &map);
-  void gen_hive_pack_map(flecs::world &ecs, std::vector<float> &map);
+  struct CoarseGraph;
+
+  enum class Backend
+  {
+    Scan,
+    Queue,
+    // opt-in, wins on open maps, where it converges in a couple of passes, but loses to Queue on caves,
+    // where every turn of a winding path costs another pass over the whole map
+    Sweep
+  };
+
+  void gen_player_approach_map(flecs::world &ecs, std::vector<float> &map, Backend backend = Backend::Queue);
+  // scan backend keeps the original approach, negate and rescan way, others go through gen_flee_map
+  void gen_player_flee_map(flecs::world &ecs, std::vector<float> &map, Backend backend = Backend::Queue);
+  void gen_hive_pack_map(flecs::world &ecs, std::vector<float> &map, Backend backend = Backend::Queue);
+
+  struct Seed
+  {
+    size_t tile;
+    float value;
+  };
+
+  void gen_map(std::vector<float> &map, const DungeonData &dd, const std::vector<Seed> &seeds,
+               Backend backend = Backend::Queue);
+  // flee map is seeded from approach map values multiplied by a negative coefficient, distances beyond
+  // maxRadius are clamped, so monsters that ran far enough stop caring which way is further
+  struct FleeParams
+  {
+    float coefficient = -1.2f;
+    float maxRadius = std::numeric_limits<float>::infinity();
+  };
+  // one Dijkstra pass from already scaled seeds instead of converging from the approach map values
+  void gen_flee_map(std::vector<float> &map, const DungeonData &dd, const std::vector<float> &approach,
+                    const FleeParams &params = {});
+
+  // tiles further than max_radius steps from their seed are left unreached, map gets sparse storage,
+  // so the cost depends on the radius instead of the dungeon size
+  void gen_bounded_map(DijkstraMapData &map, const DungeonData &dd, const std::vector<Seed> &seeds, float max_radius);
+
+  // seeds of a map that is kept between turns, so it could be repaired instead of regenerated
+  struct SeedState
+  {
+    std::vector<float> seeds; // seed value for each tile
+    std::vector<size_t> seedTiles; // sorted
+    std::vector<size_t> changed; // tiles changed by the last update
+    std::vector<uint8_t> marks; // scratch space for repairs, always zeroed between them
+    Backend backend = Backend::Queue; // used when map is generated from scratch
+  };
+
+  // full seed set, diffed against the previous one
+  void set_seeds(std::vector<float> &map, SeedState &state, const DungeonData &dd, std::vector<Seed> seeds);
+  // only changed seeds, invalid value removes the seed
+  void update_seeds(std::vector<float> &map, SeedState &state, const DungeonData &dd, const std::vector<Seed> &seeds);
+
+  // map that is being built on worker threads, it's published to DijkstraMapData after the whole turn is done
+  struct MapBuffer
+  {
+    std::vector<float> map;
+    SeedState state;
+    bool stale = false; // skipped while nobody needed it, DijkstraMapData lags behind
+    // bounded and hierarchical maps are regenerated into sparse storage every time instead of being repaired,
+    // they can't be used as a source of flee map since they don't track changes
+    float maxRadius = std::numeric_limits<float>::infinity();
+    size_t fineRadius = 0; // non zero makes map hierarchical, see dmapHierarchy.h
+    DijkstraMapData sparse;
+
+    // inputs of the last update, map isn't touched while they stay the same
+    uint64_t inputHash = 0;
+    uint64_t paramsHash = 0; // generator settings, changing them requires a full rebuild
+    size_t dungeonVersion = size_t(-1);
+    bool upToDate = false; // last update was skipped
+    size_t updates = 0;
+    size_t skippedUpdates = 0;
+  };
+
+  // seeds are gathered on the main thread, everything below that works with buffers doesn't touch ecs
+  std::vector<Seed> gather_player_seeds(flecs::world &ecs, const DungeonData &dd);
+  std::vector<Seed> gather_hive_seeds(flecs::world &ecs, const DungeonData &dd);
+
+  bool is_sparse(const MapBuffer &buf);
+  // hierarchical maps also need coarse graph of the dungeon and tiles of their consumers
+  void upd_map(MapBuffer &buf, const DungeonData &dd, const std::vector<Seed> &seeds,
+               const CoarseGraph *graph = nullptr, const std::vector<size_t> &consumers = {});
+  void upd_player_flee_map(MapBuffer &buf, const DungeonData &dd, const MapBuffer &approach,
+                           const FleeParams &params = {});
+  // brings published map up to date with the buffer, buffer keeps its own copy, so it could be published again
+  // after being skipped for a while
+  void publish_map(DijkstraMapData &dmap, MapBuffer &buf);
 };
 
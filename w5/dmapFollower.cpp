@@ -1,45 +1,117 @@
 #include "ecsTypes.h"
 #include "dmapFollower.h"
-#include <cmath>
+#include "dmapRegistry.h"
+#include <cstdint>
 
-void process_dmap_followers(flecs::world &ecs)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DMAP_FOLLOWER_SSE 1
+#else
+#define DMAP_FOLLOWER_SSE 0
+#endif
+
+// followers sharing a composite map, kept between turns so the arrays aren't reallocated
+struct FollowerBatch
 {
-  static auto processDmapFollowers = ecs.query<const Position, Action, const DmapWeights>();
-  static auto dungeonDataQuery = ecs.query<const DungeonData>();
+  std::vector<uint32_t> tiles;
+  std::vector<Action *> actions;
+  std::vector<int32_t> moves;
+};
+
+// tile offsets in EA_NOP..EA_MOVE_END order
+static void neighbour_offsets(ptrdiff_t width, ptrdiff_t offsets[EA_MOVE_END])
+{
+  offsets[EA_NOP] = 0;
+  offsets[EA_MOVE_LEFT] = -1;
+  offsets[EA_MOVE_RIGHT] = 1;
+  offsets[EA_MOVE_DOWN] = width;
+  offsets[EA_MOVE_UP] = -width;
+}
 
-  auto get_dmap_at = [&](const DijkstraMapData &dmap, const DungeonData &dd, size_t x, size_t y, float mult, float pow)
+// lowest neighbour wins, on ties the lower action index does, as EA_NOP is checked first
+static void choose_moves(const float *values, const uint32_t *tiles, size_t count, ptrdiff_t width, int32_t *moves)
+{
+  ptrdiff_t offsets[EA_MOVE_END];
+  neighbour_offsets(width, offsets);
+  size_t i = 0;
+#if DMAP_FOLLOWER_SSE
+  auto gather = [&](size_t first, ptrdiff_t offset)
   {
-    const float v = dmap.map[y * dd.width + x];
-    if (v < 1e5f)
-      return powf(v * mult, pow);
-    return v;
+    return _mm_setr_ps(values[ptrdiff_t(tiles[first + 0]) + offset], values[ptrdiff_t(tiles[first + 1]) + offset],
+                       values[ptrdiff_t(tiles[first + 2]) + offset], values[ptrdiff_t(tiles[first + 3]) + offset]);
   };
-  dungeonDataQuery.each([&](const DungeonData &dd)
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128 best = gather(i, offsets[EA_NOP]);
+    __m128i bestMove = _mm_setzero_si128();
+    for (int32_t move = EA_MOVE_START; move < EA_MOVE_END; ++move)
+    {
+      const __m128 v = gather(i, offsets[move]);
+      const __m128i better = _mm_castps_si128(_mm_cmplt_ps(v, best));
+      best = _mm_min_ps(v, best);
+      bestMove = _mm_or_si128(_mm_andnot_si128(better, bestMove), _mm_and_si128(better, _mm_set1_epi32(move)));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(moves + i), bestMove);
+  }
+#endif
+  for (; i < count; ++i)
   {
-    processDmapFollowers.each([&](const Position &pos, Action &act, const DmapWeights &wt)
+    float best = values[ptrdiff_t(tiles[i]) + offsets[EA_NOP]];
+    moves[i] = EA_NOP;
+    for (int32_t move = EA_MOVE_START; move < EA_MOVE_END; ++move)
     {
-      float moveWeights[EA_MOVE_END];
-      for (size_t i = 0; i < EA_MOVE_END; ++i)
-        moveWeights[i] = 0.f;
-      for (const auto &pair : wt.weights)
+      const float v = values[ptrdiff_t(tiles[i]) + offsets[move]];
+      if (v < best)
       {
-        ecs.entity(pair.first.c_str()).get([&](const DijkstraMapData &dmap)
-        {
-          moveWeights[EA_NOP]         += get_dmap_at(dmap, dd, pos.x+0, pos.y+0, pair.second.mult, pair.second.pow);
-          moveWeights[EA_MOVE_LEFT]   += get_dmap_at(dmap, dd, pos.x-1, pos.y+0, pair.second.mult, pair.second.pow);
-          moveWeights[EA_MOVE_RIGHT]  += get_dmap_at(dmap, dd, pos.x+1, pos.y+0, pair.second.mult, pair.second.pow);
-          moveWeights[EA_MOVE_UP]     += get_dmap_at(dmap, dd, pos.x+0, pos.y-1, pair.second.mult, pair.second.pow);
-          moveWeights[EA_MOVE_DOWN]   += get_dmap_at(dmap, dd, pos.x+0, pos.y+1, pair.second.mult, pair.second.pow);
-        });
+        best = v;
+        moves[i] = move;
       }
-      float minWt = moveWeights[EA_NOP];
-      for (size_t i = 0; i < EA_MOVE_END; ++i)
-        if (moveWeights[i] < minWt)
-        {
-          minWt = moveWeights[i];
-          act.action = i;
-        }
+    }
+  }
+}
+
+void process_dmap_followers(flecs::world &ecs)
+{
+  static auto processDmapFollowers = ecs.query<const Position, Action, const DmapWeightIds>();
+  static auto dungeonDataQuery = ecs.query<const DungeonData>();
+  static std::vector<FollowerBatch> batches;
+
+  dmaps::Registry *registry = ecs.get_mut<dmaps::Registry>();
+  const std::vector<const DijkstraMapData *> maps = dmaps::resolve_maps(ecs);
+  dungeonDataQuery.each([&](const DungeonData &dd)
+  {
+    // group followers by their composite map, SoA so that whole groups are evaluated at once
+    batches.resize(registry->composites.size());
+    for (FollowerBatch &batch : batches)
+    {
+      batch.tiles.clear();
+      batch.actions.clear();
+    }
+    processDmapFollowers.each([&](const Position &pos, Action &act, const DmapWeightIds &wt)
+    {
+      batches[wt.compositeId].tiles.push_back(uint32_t(size_t(pos.y) * dd.width + size_t(pos.x)));
+      batches[wt.compositeId].actions.push_back(&act);
     });
+
+    ptrdiff_t offsets[EA_MOVE_END];
+    neighbour_offsets(ptrdiff_t(dd.width), offsets);
+    for (size_t compositeId = 0; compositeId < batches.size(); ++compositeId)
+    {
+      FollowerBatch &batch = batches[compositeId];
+      if (batch.tiles.empty())
+        continue;
+      // make sure every tile that is read below is computed, then the composite is a plain array
+      dmaps::CompositeMap &composite = dmaps::get_composite(*registry, compositeId, dd.width * dd.height);
+      for (uint32_t tile : batch.tiles)
+        for (ptrdiff_t offset : offsets)
+          dmaps::composite_at(composite, maps, size_t(ptrdiff_t(tile) + offset));
+
+      batch.moves.resize(batch.tiles.size());
+      choose_moves(composite.values.data(), batch.tiles.data(), batch.tiles.size(), ptrdiff_t(dd.width),
+                   batch.moves.data());
+      for (size_t i = 0; i < batch.moves.size(); ++i)
+        if (batch.moves[i] != EA_NOP) // staying doesn't override what follower already decided
+          batch.actions[i]->action = batch.moves[i];
+    }
   });
 }
-
@@ -0,0 +1,223 @@
+#include "dmapHierarchy.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+constexpr size_t block_size = DijkstraMapData::chunk_size;
+constexpr float invalid_tile_value = 1e5f;
+constexpr uint8_t link_left = 1;
+constexpr uint8_t link_right = 2;
+constexpr uint8_t link_up = 4;
+constexpr uint8_t link_down = 8;
+
+void dmaps::build_coarse_graph(CoarseGraph &graph, const DungeonData &dd)
+{
+  graph.blocksX = (dd.width + block_size - 1) / block_size;
+  graph.blocksY = (dd.height + block_size - 1) / block_size;
+  graph.links.assign(graph.blocksX * graph.blocksY, 0);
+  graph.dungeonVersion = dd.version;
+  auto isFloor = [&](size_t x, size_t y) { return dd.tiles[y * dd.width + x] == dungeon::floor; };
+  // only tiles on block borders can link blocks
+  for (size_t y = 0; y < dd.height; ++y)
+    for (size_t x = block_size - 1; x + 1 < dd.width; x += block_size)
+      if (isFloor(x, y) && isFloor(x + 1, y))
+      {
+        const size_t b = (y / block_size) * graph.blocksX + x / block_size;
+        graph.links[b] |= link_right;
+        graph.links[b + 1] |= link_left;
+      }
+  for (size_t y = block_size - 1; y + 1 < dd.height; y += block_size)
+    for (size_t x = 0; x < dd.width; ++x)
+      if (isFloor(x, y) && isFloor(x, y + 1))
+      {
+        const size_t b = (y / block_size) * graph.blocksX + x / block_size;
+        graph.links[b] |= link_down;
+        graph.links[b + graph.blocksX] |= link_up;
+      }
+}
+
+static std::vector<float> coarse_dijkstra(const dmaps::CoarseGraph &graph, const DungeonData &dd,
+                                          const std::vector<dmaps::Seed> &seeds)
+{
+  std::vector<float> coarse(graph.links.size(), invalid_tile_value);
+  using OpenEntry = std::pair<float, size_t>;
+  std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry>> openList;
+  for (const dmaps::Seed &seed : seeds)
+  {
+    const size_t b = (seed.tile / dd.width / block_size) * graph.blocksX + seed.tile % dd.width / block_size;
+    if (seed.value < coarse[b])
+    {
+      coarse[b] = seed.value;
+      openList.push({seed.value, b});
+    }
+  }
+  const float edgeCost = float(block_size);
+  while (!openList.empty())
+  {
+    const auto [val, b] = openList.top();
+    openList.pop();
+    if (val != coarse[b])
+      continue;
+    auto relax = [&](uint8_t link, size_t n)
+    {
+      if ((graph.links[b] & link) && val + edgeCost < coarse[n])
+      {
+        coarse[n] = val + edgeCost;
+        openList.push({coarse[n], n});
+      }
+    };
+    relax(link_left, b - 1);
+    relax(link_right, b + 1);
+    relax(link_up, b - graph.blocksX);
+    relax(link_down, b + graph.blocksX);
+  }
+  return coarse;
+}
+
+// coarse values are distances to block centers, going through the best of the neighbour blocks
+// gives a gradient inside a block instead of a plateau
+static float coarse_estimate(const dmaps::CoarseGraph &graph, const std::vector<float> &coarse, size_t x, size_t y)
+{
+  const size_t bx = x / block_size;
+  const size_t by = y / block_size;
+  const size_t b = by * graph.blocksX + bx;
+  const float half = float(block_size / 2);
+  auto viaBlock = [&](size_t nbx, size_t nby)
+  {
+    const float dx = std::abs(float(nbx * block_size) + half - float(x));
+    const float dy = std::abs(float(nby * block_size) + half - float(y));
+    return coarse[nby * graph.blocksX + nbx] + dx + dy;
+  };
+  float res = viaBlock(bx, by);
+  if (graph.links[b] & link_left)
+    res = std::min(res, viaBlock(bx - 1, by));
+  if (graph.links[b] & link_right)
+    res = std::min(res, viaBlock(bx + 1, by));
+  if (graph.links[b] & link_up)
+    res = std::min(res, viaBlock(bx, by - 1));
+  if (graph.links[b] & link_down)
+    res = std::min(res, viaBlock(bx, by + 1));
+  return res;
+}
+
+void dmaps::gen_hierarchical_map(DijkstraMapData &map, const CoarseGraph &graph, const DungeonData &dd,
+                                 const std::vector<Seed> &seeds, const std::vector<size_t> &consumers, size_t fine_radius)
+{
+  map.storage = DijkstraMapData::Storage::Sparse;
+  map.width = dd.width;
+  map.height = dd.height;
+  map.defaultValue = invalid_tile_value;
+  map.chunks.assign(graph.links.size(), DijkstraMapData::no_chunk);
+  map.chunkValues.clear();
+  map.chunkDefaults = coarse_dijkstra(graph, dd, seeds);
+
+  // fine region is a union of windows around consumers, one bit per tile of a chunk
+  std::vector<uint64_t> region(graph.links.size(), 0);
+  auto bitOf = [&](size_t x, size_t y) { return uint64_t(1) << ((y % block_size) * block_size + x % block_size); };
+  auto chunkOf = [&](size_t x, size_t y) { return (y / block_size) * graph.blocksX + x / block_size; };
+  auto inRegion = [&](size_t x, size_t y)
+  {
+    return x < dd.width && y < dd.height && (region[chunkOf(x, y)] & bitOf(x, y)) != 0;
+  };
+  auto isFloor = [&](size_t x, size_t y) { return dd.tiles[y * dd.width + x] == dungeon::floor; };
+  for (size_t consumer : consumers)
+  {
+    const size_t cx = consumer % dd.width;
+    const size_t cy = consumer / dd.width;
+    for (size_t y = cy - std::min(cy, fine_radius); y <= std::min(cy + fine_radius, dd.height - 1); ++y)
+      for (size_t x = cx - std::min(cx, fine_radius); x <= std::min(cx + fine_radius, dd.width - 1); ++x)
+        region[chunkOf(x, y)] |= bitOf(x, y);
+  }
+
+  // chunks touched by the region are allocated up front, so the Dijkstra below never allocates
+  auto tileRef = [&](size_t x, size_t y) -> float &
+  {
+    const uint32_t chunk = map.chunks[chunkOf(x, y)];
+    return map.chunkValues[chunk * block_size * block_size + (y % block_size) * block_size + x % block_size];
+  };
+  for (size_t c = 0; c < region.size(); ++c)
+  {
+    if (!region[c])
+      continue;
+    map.chunks[c] = uint32_t(map.chunkValues.size() / (block_size * block_size));
+    map.chunkValues.resize(map.chunkValues.size() + block_size * block_size, invalid_tile_value);
+  }
+
+  // coordinates are kept along with values, so the loop below doesn't divide by width
+  struct RegionTile
+  {
+    float value;
+    size_t x;
+    size_t y;
+  };
+  std::vector<RegionTile> regionSeeds;
+  auto push = [&](size_t x, size_t y, float val)
+  {
+    float &cur = tileRef(x, y);
+    if (val < cur)
+    {
+      cur = val;
+      regionSeeds.push_back({val, x, y});
+    }
+  };
+  // region tiles on its border take far-field guidance from the coarse map,
+  // floor outside of the region in allocated chunks falls back to it as well
+  std::vector<std::pair<size_t, size_t>> fallbackTiles;
+  for (size_t c = 0; c < region.size(); ++c)
+  {
+    if (!region[c])
+      continue;
+    const size_t bx = c % graph.blocksX * block_size;
+    const size_t by = c / graph.blocksX * block_size;
+    for (size_t y = by; y < std::min(by + block_size, dd.height); ++y)
+      for (size_t x = bx; x < std::min(bx + block_size, dd.width); ++x)
+      {
+        if (!isFloor(x, y))
+          continue;
+        if (!inRegion(x, y))
+          fallbackTiles.emplace_back(x, y);
+        else if (!inRegion(x - 1, y) || !inRegion(x + 1, y) || !inRegion(x, y - 1) || !inRegion(x, y + 1))
+          push(x, y, coarse_estimate(graph, map.chunkDefaults, x, y));
+      }
+  }
+  for (const Seed &seed : seeds)
+  {
+    const size_t x = seed.tile % dd.width;
+    const size_t y = seed.tile / dd.width;
+    if (inRegion(x, y))
+      push(x, y, seed.value);
+  }
+
+  // all edges cost 1, so sorted seeds merged with a FIFO work as Dijkstra, same as in the queue generator
+  std::sort(regionSeeds.begin(), regionSeeds.end(),
+            [](const RegionTile &a, const RegionTile &b) { return a.value < b.value; });
+  std::vector<RegionTile> queue;
+  size_t head = 0;
+  size_t seedIdx = 0;
+  while (head < queue.size() || seedIdx < regionSeeds.size())
+  {
+    RegionTile cur;
+    if (head == queue.size() || (seedIdx < regionSeeds.size() && regionSeeds[seedIdx].value <= queue[head].value))
+      cur = regionSeeds[seedIdx++];
+    else
+      cur = queue[head++];
+    // entry is outdated if the tile was improved after it had been pushed
+    if (cur.value != tileRef(cur.x, cur.y) || !isFloor(cur.x, cur.y))
+      continue;
+    auto relax = [&](size_t nx, size_t ny)
+    {
+      if (inRegion(nx, ny) && isFloor(nx, ny) && cur.value < tileRef(nx, ny) - 1.f)
+      {
+        tileRef(nx, ny) = cur.value + 1.f;
+        queue.push_back({cur.value + 1.f, nx, ny});
+      }
+    };
+    relax(cur.x - 1, cur.y + 0);
+    relax(cur.x + 1, cur.y + 0);
+    relax(cur.x + 0, cur.y - 1);
+    relax(cur.x + 0, cur.y + 1);
+  }
+  for (const auto &[x, y] : fallbackTiles)
+    tileRef(x, y) = map.chunkDefaults[chunkOf(x, y)];
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "ecsTypes.h"
+#include "dijkstraMapGen.h"
+
+namespace dmaps
+{
+  // one node per chunk_size x chunk_size block of the dungeon, neighbour blocks are linked
+  // if any floor tile of one touches a floor tile of the other
+  struct CoarseGraph
+  {
+    size_t blocksX = 0;
+    size_t blocksY = 0;
+    std::vector<uint8_t> links; // bit per direction: left, right, up, down
+    size_t dungeonVersion = size_t(-1);
+  };
+
+  void build_coarse_graph(CoarseGraph &graph, const DungeonData &dd);
+
+  // coarse distances between block centers are stored as chunk defaults of sparse map, exact tile values are
+  // computed only in fine_radius around consumers, window borders are seeded from coarse values
+  void gen_hierarchical_map(DijkstraMapData &map, const CoarseGraph &graph, const DungeonData &dd,
+                            const std::vector<Seed> &seeds, const std::vector<size_t> &consumers, size_t fine_radius);
+};
+
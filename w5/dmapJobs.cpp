@@ -0,0 +1,28 @@
+#include "dmapJobs.h"
+#include <future>
+
+size_t dmaps::add_job(JobGraph &graph, std::function<void()> func, std::vector<size_t> deps)
+{
+  graph.jobs.push_back({std::move(func), std::move(deps)});
+  return graph.jobs.size() - 1;
+}
+
+void dmaps::run_jobs(const JobGraph &graph)
+{
+  std::vector<std::shared_future<void>> done;
+  done.reserve(graph.jobs.size());
+  for (const JobGraph::Job &job : graph.jobs)
+  {
+    std::vector<std::shared_future<void>> deps;
+    for (size_t dep : job.deps)
+      deps.push_back(done[dep]);
+    done.push_back(std::async(std::launch::async, [&job, deps = std::move(deps)]()
+    {
+      for (const std::shared_future<void> &dep : deps)
+        dep.wait();
+      job.func();
+    }).share());
+  }
+  for (const std::shared_future<void> &job : done)
+    job.get();
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <functional>
+#include <vector>
+
+namespace dmaps
+{
+  struct JobGraph
+  {
+    struct Job
+    {
+      std::function<void()> func;
+      std::vector<size_t> deps;
+    };
+    std::vector<Job> jobs;
+  };
+
+  // dependencies should be added before the job, so graph is always in topological order
+  size_t add_job(JobGraph &graph, std::function<void()> func, std::vector<size_t> deps = {});
+  // runs every job on a worker thread as soon as all of its dependencies are done, returns when all are done
+  void run_jobs(const JobGraph &graph);
+};
+
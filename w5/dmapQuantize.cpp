@@ -0,0 +1,129 @@
+#include "dmapQuantize.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DMAP_QUANTIZE_SSE 1
+#else
+#define DMAP_QUANTIZE_SSE 0
+#endif
+
+constexpr float quant_invalid = 1e5f; // same as in map generation
+constexpr float max_fixed = 65534.f; // 0xffff is reserved for invalid tiles
+constexpr float quant_inf = std::numeric_limits<float>::infinity();
+
+struct ValueRange
+{
+  float lo = quant_inf;
+  float hi = -quant_inf;
+};
+
+static ValueRange valid_range(const std::vector<float> &map)
+{
+  ValueRange res;
+  size_t i = 0;
+#if DMAP_QUANTIZE_SSE
+  const __m128 invalid = _mm_set1_ps(quant_invalid);
+  const __m128 inf = _mm_set1_ps(quant_inf);
+  __m128 lo = inf;
+  __m128 hi = _mm_set1_ps(-quant_inf);
+  for (; i + 4 <= map.size(); i += 4)
+  {
+    const __m128 v = _mm_loadu_ps(map.data() + i);
+    const __m128 valid = _mm_cmplt_ps(v, invalid);
+    lo = _mm_min_ps(lo, _mm_or_ps(_mm_and_ps(valid, v), _mm_andnot_ps(valid, inf)));
+    hi = _mm_max_ps(hi, _mm_or_ps(_mm_and_ps(valid, v), _mm_andnot_ps(valid, _mm_sub_ps(_mm_setzero_ps(), inf))));
+  }
+  lo = _mm_min_ps(lo, _mm_shuffle_ps(lo, lo, _MM_SHUFFLE(1, 0, 3, 2)));
+  lo = _mm_min_ps(lo, _mm_shuffle_ps(lo, lo, _MM_SHUFFLE(2, 3, 0, 1)));
+  hi = _mm_max_ps(hi, _mm_shuffle_ps(hi, hi, _MM_SHUFFLE(1, 0, 3, 2)));
+  hi = _mm_max_ps(hi, _mm_shuffle_ps(hi, hi, _MM_SHUFFLE(2, 3, 0, 1)));
+  res.lo = _mm_cvtss_f32(lo);
+  res.hi = _mm_cvtss_f32(hi);
+#endif
+  for (; i < map.size(); ++i)
+    if (map[i] < quant_invalid)
+    {
+      res.lo = std::min(res.lo, map[i]);
+      res.hi = std::max(res.hi, map[i]);
+    }
+  return res;
+}
+
+// power of two steps keep integer distances exact
+static float choose_step(float range)
+{
+  return std::exp2(std::ceil(std::log2(std::max(range, 1.f) / max_fixed)));
+}
+
+static uint16_t quantize_value(float v, float offset, float inv_step)
+{
+  if (v >= quant_invalid)
+    return DijkstraMapData::invalid_fixed;
+  return uint16_t(std::nearbyint(std::clamp((v - offset) * inv_step, 0.f, max_fixed)));
+}
+
+static void quantize_span(const float *src, uint16_t *dst, size_t count, float offset, float inv_step)
+{
+  size_t i = 0;
+#if DMAP_QUANTIZE_SSE
+  const __m128 invalid = _mm_set1_ps(quant_invalid);
+  const __m128 offs = _mm_set1_ps(offset);
+  const __m128 scale = _mm_set1_ps(inv_step);
+  const __m128 maxFixed = _mm_set1_ps(max_fixed);
+  const __m128i invalidFixed = _mm_set1_epi32(DijkstraMapData::invalid_fixed);
+  const __m128i bias = _mm_set1_epi32(0x8000);
+  auto convert = [&](__m128 v)
+  {
+    const __m128 q = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(v, offs), scale), _mm_setzero_ps()), maxFixed);
+    const __m128i invalidMask = _mm_castps_si128(_mm_cmpge_ps(v, invalid));
+    const __m128i res = _mm_or_si128(_mm_andnot_si128(invalidMask, _mm_cvtps_epi32(q)), _mm_and_si128(invalidMask, invalidFixed));
+    // there's no unsigned saturating pack in sse2, so shift to signed range and back
+    return _mm_sub_epi32(res, bias);
+  };
+  for (; i + 8 <= count; i += 8)
+  {
+    const __m128i packed = _mm_packs_epi32(convert(_mm_loadu_ps(src + i)), convert(_mm_loadu_ps(src + i + 4)));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_xor_si128(packed, _mm_set1_epi16(-0x8000)));
+  }
+#endif
+  for (; i < count; ++i)
+    dst[i] = quantize_value(src[i], offset, inv_step);
+}
+
+void dmaps::quantize_map(DijkstraMapData &dmap, const std::vector<float> &map, const std::vector<size_t> &changed, bool full)
+{
+  // changed tiles that fit into the current offset and step are converted on their own, the map is only scanned
+  // for its range when one of them doesn't, so the step is kept even if the range shrinks meanwhile
+  if (!full && dmap.fixedMap.size() == map.size())
+  {
+    const float capacity = max_fixed * dmap.step;
+    const bool fits = std::all_of(changed.begin(), changed.end(), [&](size_t i)
+    {
+      return map[i] >= quant_invalid || (map[i] >= dmap.offset && map[i] <= dmap.offset + capacity);
+    });
+    if (fits)
+    {
+      const float invStep = 1.f / dmap.step;
+      for (size_t i : changed)
+        dmap.fixedMap[i] = quantize_value(map[i], dmap.offset, invStep);
+      return;
+    }
+  }
+  const ValueRange range = valid_range(map);
+  if (range.lo <= range.hi)
+  {
+    const float step = choose_step(range.hi - range.lo);
+    const float capacity = max_fixed * step;
+    if (step != dmap.step || range.lo < dmap.offset || range.hi > dmap.offset + capacity)
+    {
+      // leave some room on both sides, so small changes of the range don't require a full rewrite
+      dmap.step = step;
+      dmap.offset = std::floor((range.lo - (capacity - (range.hi - range.lo)) * 0.5f) / step) * step;
+    }
+  }
+  dmap.fixedMap.resize(map.size());
+  quantize_span(map.data(), dmap.fixedMap.data(), map.size(), dmap.offset, 1.f / dmap.step);
+}
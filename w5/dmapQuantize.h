@@ -0,0 +1,11 @@
+#pragma once
+#include <vector>
+#include "ecsTypes.h"
+
+namespace dmaps
+{
+  // publishes float map into the fixed point storage of dmap, only changed tiles are converted
+  // unless full is set or the value range doesn't fit into the current offset and step anymore
+  void quantize_map(DijkstraMapData &dmap, const std::vector<float> &map, const std::vector<size_t> &changed, bool full);
+};
+
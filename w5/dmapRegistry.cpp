@@ -0,0 +1,141 @@
+#include "dmapRegistry.h"
+#include "dijkstraMapGen.h"
+#include <algorithm>
+#include <cmath>
+
+// weights have to be sorted by map id, so the order in DmapWeights doesn't matter
+static size_t intern_composite(dmaps::Registry &registry, const std::vector<DmapWeightIds::Entry> &weights)
+{
+  dmaps::Registry::Signature signature;
+  for (const DmapWeightIds::Entry &entry : weights)
+    signature.emplace_back(entry.mapId, entry.mult, entry.pow);
+  auto itf = registry.compositeIds.find(signature);
+  if (itf != registry.compositeIds.end())
+    return itf->second;
+  const size_t id = registry.composites.size();
+  registry.compositeIds.emplace(std::move(signature), id);
+  registry.composites.push_back({});
+  registry.composites.back().weights = weights;
+  return id;
+}
+
+void dmaps::init_registry(flecs::world &ecs)
+{
+  ecs.set(Registry{});
+
+  ecs.observer<const DmapWeights>()
+    .event(flecs::OnSet)
+    .each([&](flecs::entity e, const DmapWeights &wt)
+    {
+      DmapWeightIds ids;
+      for (const auto &pair : wt.weights)
+        ids.weights.push_back({intern_map(ecs, pair.first), pair.second.mult, pair.second.pow});
+      std::sort(ids.weights.begin(), ids.weights.end(),
+                [](const DmapWeightIds::Entry &a, const DmapWeightIds::Entry &b) { return a.mapId < b.mapId; });
+      ids.compositeId = intern_composite(*ecs.get_mut<Registry>(), ids.weights);
+      e.set(ids);
+    });
+}
+
+size_t dmaps::intern_map(flecs::world &ecs, const std::string &name)
+{
+  Registry *registry = ecs.get_mut<Registry>();
+  auto itf = registry->ids.find(name);
+  if (itf != registry->ids.end())
+    return itf->second;
+  const size_t id = registry->maps.size();
+  registry->ids.emplace(name, id);
+  registry->versions.push_back(0);
+  registry->maps.push_back(ecs.entity(name.c_str())
+    .set(MapId{id})
+    .set(DijkstraMapData{})
+    .set(MapBuffer{}));
+  return id;
+}
+
+std::vector<bool> dmaps::gather_demanded_maps(flecs::world &ecs)
+{
+  static auto weightsQuery = ecs.query<const DmapWeightIds>();
+  static auto visualisedQuery = ecs.query<const MapId, const VisualiseMap>();
+  std::vector<bool> demanded(ecs.get<Registry>()->maps.size(), false);
+  weightsQuery.each([&](const DmapWeightIds &wt)
+  {
+    for (const DmapWeightIds::Entry &entry : wt.weights)
+      demanded[entry.mapId] = true;
+  });
+  visualisedQuery.each([&](const MapId &map, const VisualiseMap &)
+  {
+    demanded[map.id] = true;
+  });
+  return demanded;
+}
+
+std::vector<size_t> dmaps::gather_map_consumers(flecs::world &ecs, const DungeonData &dd, size_t map_id)
+{
+  static auto consumersQuery = ecs.query<const Position, const DmapWeightIds>();
+  std::vector<size_t> consumers;
+  consumersQuery.each([&](const Position &pos, const DmapWeightIds &wt)
+  {
+    for (const DmapWeightIds::Entry &entry : wt.weights)
+      if (entry.mapId == map_id)
+      {
+        consumers.push_back(size_t(pos.y) * dd.width + size_t(pos.x));
+        break;
+      }
+  });
+  return consumers;
+}
+
+std::vector<const DijkstraMapData *> dmaps::resolve_maps(flecs::world &ecs)
+{
+  const Registry *registry = ecs.get<Registry>();
+  std::vector<const DijkstraMapData *> res;
+  res.reserve(registry->maps.size());
+  for (const flecs::entity &map : registry->maps)
+  {
+    const DijkstraMapData *dmap = map.get<DijkstraMapData>();
+    res.push_back(dmap && dmap->size() > 0 ? dmap : nullptr);
+  }
+  return res;
+}
+
+dmaps::CompositeMap &dmaps::get_composite(Registry &registry, size_t composite_id, size_t num_tiles)
+{
+  CompositeMap &composite = registry.composites[composite_id];
+  bool outdated = composite.values.size() != num_tiles;
+  composite.inputVersions.resize(composite.weights.size(), size_t(-1));
+  for (size_t i = 0; i < composite.weights.size(); ++i)
+  {
+    const size_t version = registry.versions[composite.weights[i].mapId];
+    outdated |= composite.inputVersions[i] != version;
+    composite.inputVersions[i] = version;
+  }
+  if (outdated)
+  {
+    composite.values.resize(num_tiles);
+    composite.tileStamps.resize(num_tiles, 0);
+    composite.stamp++;
+  }
+  return composite;
+}
+
+float dmaps::composite_at(CompositeMap &composite, const std::vector<const DijkstraMapData *> &maps, size_t tile)
+{
+  if (composite.tileStamps[tile] == composite.stamp)
+    return composite.values[tile];
+  float sum = 0.f;
+  for (const DmapWeightIds::Entry &entry : composite.weights)
+  {
+    const DijkstraMapData *dmap = maps[entry.mapId];
+    if (!dmap)
+      continue;
+    const float v = dmap->at(tile);
+    if (v < 1e5f)
+      sum += powf(v * entry.mult, entry.pow);
+    else
+      sum += v;
+  }
+  composite.tileStamps[tile] = composite.stamp;
+  composite.values[tile] = sum;
+  return sum;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <flecs.h>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include "ecsTypes.h"
+
+namespace dmaps
+{
+  // weighted sum of several maps, tiles are computed lazily on first read after any of the inputs changed
+  struct CompositeMap
+  {
+    std::vector<DmapWeightIds::Entry> weights;
+    std::vector<size_t> inputVersions;
+    std::vector<float> values;
+    std::vector<uint32_t> tileStamps;
+    uint32_t stamp = 0;
+  };
+
+  // world singleton, map names are interned once and everything per turn works with indices into it
+  struct Registry
+  {
+    std::vector<flecs::entity> maps;
+    std::vector<size_t> versions; // bumped each time map is published
+    std::unordered_map<std::string, size_t> ids;
+
+    using Signature = std::vector<std::tuple<size_t, float, float>>;
+    std::vector<CompositeMap> composites;
+    std::map<Signature, size_t> compositeIds;
+  };
+
+  // component of map entities, index in the registry
+  struct MapId
+  {
+    size_t id;
+  };
+
+  void init_registry(flecs::world &ecs);
+  // creates map entity on first use
+  size_t intern_map(flecs::world &ecs, const std::string &name);
+
+  // maps referenced by any DmapWeights or visualised directly, indexed by map id
+  std::vector<bool> gather_demanded_maps(flecs::world &ecs);
+  // tiles of entities that have the map in their DmapWeights
+  std::vector<size_t> gather_map_consumers(flecs::world &ecs, const DungeonData &dd, size_t map_id);
+  // direct pointers for this turn, nullptr for maps that weren't generated yet
+  std::vector<const DijkstraMapData *> resolve_maps(flecs::world &ecs);
+
+  // drops cached tiles if any of the input maps was published since the last call
+  CompositeMap &get_composite(Registry &registry, size_t composite_id, size_t num_tiles);
+  float composite_at(CompositeMap &composite, const std::vector<const DijkstraMapData *> &maps, size_t tile);
+};
+
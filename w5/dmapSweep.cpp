@@ -0,0 +1,218 @@
+#include "dmapSweep.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DMAP_SWEEP_SSE 1
+#else
+#define DMAP_SWEEP_SSE 0
+#endif
+
+constexpr float sweep_inf = std::numeric_limits<float>::infinity();
+constexpr size_t sweep_lanes = 4;
+
+// rows are padded with walls up to a multiple of sweep_lanes
+struct SweepGrid
+{
+  size_t stride;
+  std::vector<float> values;
+  std::vector<float> wallMask; // +inf for walls, -inf for floor, so max() with it keeps walls unreachable
+  std::vector<int32_t> segments; // index of floor span inside a row, -2 for walls
+};
+
+static SweepGrid make_sweep_grid(const std::vector<float> &map, const DungeonData &dd, float invalid_value)
+{
+  SweepGrid grid;
+  grid.stride = (dd.width + sweep_lanes - 1) / sweep_lanes * sweep_lanes;
+  grid.values.assign(grid.stride * dd.height, sweep_inf);
+  grid.wallMask.assign(grid.stride * dd.height, sweep_inf);
+  grid.segments.assign(grid.stride * dd.height, -2);
+  for (size_t y = 0; y < dd.height; ++y)
+  {
+    int32_t segment = 0;
+    bool inSpan = false;
+    for (size_t x = 0; x < dd.width; ++x)
+    {
+      const size_t i = y * dd.width + x;
+      const size_t j = y * grid.stride + x;
+      if (dd.tiles[i] == dungeon::floor)
+      {
+        grid.values[j] = map[i] < invalid_value ? map[i] : sweep_inf;
+        grid.wallMask[j] = -sweep_inf;
+        grid.segments[j] = segment;
+        inSpan = true;
+      }
+      else if (inSpan)
+      {
+        segment++;
+        inSpan = false;
+      }
+    }
+  }
+  return grid;
+}
+
+#if DMAP_SWEEP_SSE
+
+static __m128 min_masked(__m128 v, __m128 candidate, __m128i mask)
+{
+  const __m128 m = _mm_castsi128_ps(mask);
+  return _mm_min_ps(v, _mm_or_ps(_mm_and_ps(m, candidate), _mm_andnot_ps(m, _mm_set1_ps(sweep_inf))));
+}
+
+// lane i gets lane i - N, missing lanes get -1 segment so they never match
+template<int N>
+static __m128 lanes_up(__m128 v) { return _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), N * 4)); }
+template<int N>
+static __m128 lanes_down(__m128 v) { return _mm_castsi128_ps(_mm_srli_si128(_mm_castps_si128(v), N * 4)); }
+
+static bool relax_row(float *row, const float *prev, const float *wall_mask, size_t stride)
+{
+  const __m128 one = _mm_set1_ps(1.f);
+  int changed = 0;
+  for (size_t x = 0; x < stride; x += sweep_lanes)
+  {
+    const __m128 cur = _mm_loadu_ps(row + x);
+    const __m128 candidate = _mm_max_ps(_mm_add_ps(_mm_loadu_ps(prev + x), one), _mm_loadu_ps(wall_mask + x));
+    const __m128 res = _mm_min_ps(cur, candidate);
+    changed |= _mm_movemask_ps(_mm_cmplt_ps(res, cur));
+    _mm_storeu_ps(row + x, res);
+  }
+  return changed != 0;
+}
+
+// prefix-min along the row in both directions, v[x] = min(v[k] + |x - k|) over k in the same floor span
+static bool scan_row(float *row, const int32_t *segments, size_t stride)
+{
+  const __m128 one = _mm_set1_ps(1.f);
+  const __m128 two = _mm_set1_ps(2.f);
+  int changed = 0;
+
+  const __m128i noSegUp1 = _mm_setr_epi32(-1, 0, 0, 0);
+  const __m128i noSegUp2 = _mm_setr_epi32(-1, -1, 0, 0);
+  const __m128 offsUp = _mm_setr_ps(1.f, 2.f, 3.f, 4.f);
+  __m128 carry = _mm_set1_ps(sweep_inf);
+  __m128i carrySeg = _mm_set1_epi32(-1);
+  for (size_t x = 0; x < stride; x += sweep_lanes)
+  {
+    const __m128 orig = _mm_loadu_ps(row + x);
+    const __m128i seg = _mm_loadu_si128(reinterpret_cast<const __m128i *>(segments + x));
+    __m128 v = orig;
+    v = min_masked(v, _mm_add_ps(lanes_up<1>(v), one), _mm_cmpeq_epi32(seg, _mm_or_si128(_mm_slli_si128(seg, 4), noSegUp1)));
+    v = min_masked(v, _mm_add_ps(lanes_up<2>(v), two), _mm_cmpeq_epi32(seg, _mm_or_si128(_mm_slli_si128(seg, 8), noSegUp2)));
+    v = min_masked(v, _mm_add_ps(carry, offsUp), _mm_cmpeq_epi32(seg, carrySeg));
+    changed |= _mm_movemask_ps(_mm_cmplt_ps(v, orig));
+    _mm_storeu_ps(row + x, v);
+    carry = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+    carrySeg = _mm_shuffle_epi32(seg, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+
+  const __m128i noSegDown1 = _mm_setr_epi32(0, 0, 0, -1);
+  const __m128i noSegDown2 = _mm_setr_epi32(0, 0, -1, -1);
+  const __m128 offsDown = _mm_setr_ps(4.f, 3.f, 2.f, 1.f);
+  carry = _mm_set1_ps(sweep_inf);
+  carrySeg = _mm_set1_epi32(-1);
+  for (size_t x = stride; x > 0; x -= sweep_lanes)
+  {
+    const size_t bx = x - sweep_lanes;
+    const __m128 orig = _mm_loadu_ps(row + bx);
+    const __m128i seg = _mm_loadu_si128(reinterpret_cast<const __m128i *>(segments + bx));
+    __m128 v = orig;
+    v = min_masked(v, _mm_add_ps(lanes_down<1>(v), one), _mm_cmpeq_epi32(seg, _mm_or_si128(_mm_srli_si128(seg, 4), noSegDown1)));
+    v = min_masked(v, _mm_add_ps(lanes_down<2>(v), two), _mm_cmpeq_epi32(seg, _mm_or_si128(_mm_srli_si128(seg, 8), noSegDown2)));
+    v = min_masked(v, _mm_add_ps(carry, offsDown), _mm_cmpeq_epi32(seg, carrySeg));
+    changed |= _mm_movemask_ps(_mm_cmplt_ps(v, orig));
+    _mm_storeu_ps(row + bx, v);
+    carry = _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0));
+    carrySeg = _mm_shuffle_epi32(seg, _MM_SHUFFLE(0, 0, 0, 0));
+  }
+  return changed != 0;
+}
+
+#else
+
+static bool relax_row(float *row, const float *prev, const float *wall_mask, size_t stride)
+{
+  bool changed = false;
+  for (size_t x = 0; x < stride; ++x)
+  {
+    const float candidate = std::max(prev[x] + 1.f, wall_mask[x]);
+    if (candidate < row[x])
+    {
+      row[x] = candidate;
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+static bool scan_row(float *row, const int32_t *segments, size_t stride)
+{
+  bool changed = false;
+  for (size_t x = 1; x < stride; ++x)
+    if (segments[x] >= 0 && segments[x] == segments[x - 1] && row[x - 1] + 1.f < row[x])
+    {
+      row[x] = row[x - 1] + 1.f;
+      changed = true;
+    }
+  for (size_t x = stride - 1; x > 0; --x)
+    if (segments[x - 1] >= 0 && segments[x - 1] == segments[x] && row[x] + 1.f < row[x - 1])
+    {
+      row[x - 1] = row[x] + 1.f;
+      changed = true;
+    }
+  return changed;
+}
+
+#endif
+
+void dmaps::sweep_dmap(std::vector<float> &map, const DungeonData &dd, float invalid_value)
+{
+  SweepGrid grid = make_sweep_grid(map, dd, invalid_value);
+  const size_t stride = grid.stride;
+  auto rowAt = [&](size_t y) { return grid.values.data() + y * stride; };
+  auto scanRow = [&](size_t y) { return scan_row(rowAt(y), grid.segments.data() + y * stride, stride); };
+
+  // rows are only revisited when their neighbour changed after they were relaxed against it,
+  // so the final pass that confirms convergence costs almost nothing
+  size_t counter = 1;
+  std::vector<size_t> changedAt(dd.height, 0);
+  std::vector<size_t> seenAbove(dd.height, 0);
+  std::vector<size_t> seenBelow(dd.height, 0);
+  for (size_t y = 0; y < dd.height; ++y)
+  {
+    scanRow(y);
+    changedAt[y] = counter;
+  }
+  auto relaxFrom = [&](size_t y, size_t from, std::vector<size_t> &seen)
+  {
+    if (changedAt[from] <= seen[y])
+      return false;
+    seen[y] = ++counter;
+    if (!relax_row(rowAt(y), rowAt(from), grid.wallMask.data() + y * stride, stride))
+      return false;
+    scanRow(y);
+    changedAt[y] = ++counter;
+    return true;
+  };
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (size_t y = 1; y < dd.height; ++y)
+      changed |= relaxFrom(y, y - 1, seenAbove);
+    for (size_t y = dd.height - 1; y > 0; --y)
+      changed |= relaxFrom(y - 1, y, seenBelow);
+  }
+
+  for (size_t y = 0; y < dd.height; ++y)
+    for (size_t x = 0; x < dd.width; ++x)
+      if (dd.tiles[y * dd.width + x] == dungeon::floor)
+      {
+        const float val = grid.values[y * stride + x];
+        map[y * dd.width + x] = val < sweep_inf ? val : invalid_value;
+      }
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <vector>
+#include "ecsTypes.h"
+
+namespace dmaps
+{
+  // fast sweeping: alternating top-down and bottom-up passes where each row is relaxed against the previous one
+  // and then scanned in both directions, repeated until nothing changes
+  void sweep_dmap(std::vector<float> &map, const DungeonData &dd, float invalid_value);
+};
+
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -143,11 +144,55 @@ struct DungeonData
   std::vector<char> tiles; // for pathfinding
   size_t width;
   size_t height;
+  size_t version = 0; // has to be bumped whenever tiles change, maps built for older versions are rebuilt
 };
 
 struct DijkstraMapData
 {
+  enum class Storage
+  {
+    Float,
+    Fixed, // 16 bit fixed point, value = offset + q * step
+    Sparse // chunks are allocated only where the map was reached, for radius-bounded maps
+  };
+  static constexpr uint16_t invalid_fixed = 0xffff;
+  static constexpr size_t chunk_size = 8;
+  static constexpr uint32_t no_chunk = 0xffffffff;
+
+  Storage storage = Storage::Float;
   std::vector<float> map;
+
+  std::vector<uint16_t> fixedMap;
+  float offset = 0.f;
+  float step = 1.f;
+
+  size_t width = 0;
+  size_t height = 0;
+  std::vector<uint32_t> chunks; // index of chunk in chunkValues for every chunk_size x chunk_size block
+  std::vector<float> chunkValues;
+  float defaultValue = 1e5f; // for tiles in chunks that weren't reached
+  std::vector<float> chunkDefaults; // optional per chunk fallback instead of defaultValue, e.g. coarse estimate
+
+  size_t size() const
+  {
+    if (storage == Storage::Sparse)
+      return chunks.empty() ? 0 : width * height;
+    return storage == Storage::Fixed ? fixedMap.size() : map.size();
+  }
+  float at(size_t i) const
+  {
+    if (storage == Storage::Float)
+      return map[i];
+    if (storage == Storage::Fixed)
+      return fixedMap[i] == invalid_fixed ? 1e5f : offset + float(fixedMap[i]) * step;
+    const size_t x = i % width;
+    const size_t y = i / width;
+    const size_t chunkIdx = (y / chunk_size) * ((width + chunk_size - 1) / chunk_size) + x / chunk_size;
+    const uint32_t chunk = chunks[chunkIdx];
+    if (chunk == no_chunk)
+      return chunkDefaults.empty() ? defaultValue : chunkDefaults[chunkIdx];
+    return chunkValues[chunk * chunk_size * chunk_size + (y % chunk_size) * chunk_size + x % chunk_size];
+  }
 };
 
 struct VisualiseMap {};
@@ -158,8 +203,25 @@ struct DmapWeights
   {
     float mult = 1.f;
     float pow = 1.f;
+
+    bool operator==(const WtData &) const = default;
   };
   std::unordered_map<std::string, WtData> weights;
+
+  bool operator==(const DmapWeights &) const = default;
+};
+
+// DmapWeights with map names resolved to registry indices, kept in sync by an observer
+struct DmapWeightIds
+{
+  struct Entry
+  {
+    size_t mapId;
+    float mult;
+    float pow;
+  };
+  std::vector<Entry> weights; // sorted by map id
+  size_t compositeId; // entities with the same weights share one composite map
 };
 
 struct Hive {};
@@ -14,28 +14,43 @@ goap::Action goap::create_action(const char *name, const WorldDesc &desc, float
   return res;
 }
 
+static void compile_effect(goap::Action &act, size_t idx)
+{
+  if (idx >= goap::max_world_state_size)
+    return;
+  const int8_t val = act.effect[idx];
+  const bool additive = !act.setBitset[idx];
+  act.setMask.values[idx] = !additive && val >= 0 ? int8_t(-1) : int8_t(0);
+  act.setValues.values[idx] = !additive && val >= 0 ? val : int8_t(0);
+  act.addValues.values[idx] = additive ? val : int8_t(0);
+}
+
 void goap::set_action_precond(Action &act, const WorldDesc &desc, const char *st_name, int8_t val)
 {
   auto itf = desc.find(st_name);
-  if (itf == desc.end())
+  if (itf == desc.end() || itf->second >= max_world_state_size)
     return; // TODO: Assert
   act.precondition[itf->second] = val;
+  act.care.values[itf->second] = val < 0 ? int8_t(0) : int8_t(-1);
+  act.precondValues.values[itf->second] = val < 0 ? int8_t(0) : val;
 }
 
 void goap::set_action_effect(Action &act, const WorldDesc &desc, const char *st_name, int8_t val)
 {
   auto itf = desc.find(st_name);
-  if (itf == desc.end())
+  if (itf == desc.end() || itf->second >= max_world_state_size)
     return; // TODO: Assert
   act.effect[itf->second] = val;
+  compile_effect(act, itf->second);
 }
 
 void goap::set_additive_action_effect(Action &act, const WorldDesc &desc, const char *st_name, int8_t val)
 {
   auto itf = desc.find(st_name);
-  if (itf == desc.end())
+  if (itf == desc.end() || itf->second >= max_world_state_size)
     return; // TODO: Assert
   act.effect[itf->second] = val;
   act.setBitset[itf->second] = false;
+  compile_effect(act, itf->second);
 }
 
@@ -5,6 +5,12 @@
 namespace goap
 {
 
+  // whole-state lanes, one int8 per world state slot, zero where the action doesn't touch the slot
+  struct alignas(16) SlotVector
+  {
+    int8_t values[max_world_state_size] = {};
+  };
+
   struct Action
   {
     std::string name = "";
@@ -14,6 +20,14 @@ namespace goap
 
     std::vector<bool> setBitset; // if effect sets world state, or is it additive (true - sets, false - additive)
 
+    // precondition and effect compiled into masks, kept in sync by the set_action_* functions:
+    // valid when (state & care) == precondValues, applied as (state & ~setMask) | setValues + addValues
+    SlotVector care;
+    SlotVector precondValues;
+    SlotVector setMask;
+    SlotVector setValues;
+    SlotVector addValues;
+
     float cost = 1.f;
   };
 
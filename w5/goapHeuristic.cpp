@@ -0,0 +1,184 @@
+#include "goapHeuristic.h"
+#include <algorithm>
+#include <limits>
+
+constexpr size_t facts_per_slot = 256;
+constexpr float unreachable = std::numeric_limits<float>::infinity();
+constexpr size_t max_cached_problems = 16;
+
+static size_t fact_id(size_t slot, int value)
+{
+  return slot * facts_per_slot + uint8_t(int8_t(value));
+}
+
+struct RelaxedAction
+{
+  std::vector<size_t> precond;
+  std::vector<size_t> sets;
+  std::vector<std::pair<size_t, int>> adds; // slot and delta
+  float cost;
+};
+
+// additive effects wrap around like apply_action does, so they can reach any value of their slot,
+// clamping those to values mentioned in the problem would make solvable states look like dead ends
+struct RelaxedProblem
+{
+  uint64_t version;
+  std::vector<RelaxedAction> actions;
+  std::vector<std::vector<size_t>> precondUsers; // per fact
+  std::vector<std::vector<size_t>> slotAdders; // per slot
+};
+
+static void compile_problem(RelaxedProblem &p, const goap::Planner &planner)
+{
+  const size_t numSlots = planner.wdesc.size();
+  p.version = planner.version;
+  p.actions.clear();
+  p.precondUsers.assign(numSlots * facts_per_slot, {});
+  p.slotAdders.assign(numSlots, {});
+  for (size_t a = 0; a < planner.actions.size(); ++a)
+  {
+    const goap::Action &action = planner.actions[a];
+    RelaxedAction res;
+    res.cost = action.cost;
+    for (size_t i = 0; i < numSlots; ++i)
+    {
+      if (action.precondition[i] >= 0)
+      {
+        res.precond.push_back(fact_id(i, action.precondition[i]));
+        p.precondUsers[res.precond.back()].push_back(a);
+      }
+      if (!action.setBitset[i] && action.effect[i] != 0)
+      {
+        res.adds.emplace_back(i, action.effect[i]);
+        p.slotAdders[i].push_back(a);
+      }
+      else if (action.setBitset[i] && action.effect[i] >= 0)
+        res.sets.push_back(fact_id(i, action.effect[i]));
+    }
+    p.actions.push_back(std::move(res));
+  }
+}
+
+static const RelaxedProblem &get_problem(const goap::Planner &planner)
+{
+  static thread_local std::vector<RelaxedProblem> problems;
+  for (const RelaxedProblem &p : problems)
+    if (p.version == planner.version)
+      return p;
+  if (problems.size() >= max_cached_problems)
+    problems.erase(problems.begin());
+  problems.emplace_back();
+  compile_problem(problems.back(), planner);
+  return problems.back();
+}
+
+// generalized Dijkstra over facts, with a goal it stops as soon as all goal facts got their final costs
+static void explore_facts(const goap::Planner &planner, goap::PlanHeuristic heuristic, const goap::WorldState &from,
+                          const goap::WorldState *goal, std::vector<float> &costs)
+{
+  const RelaxedProblem &p = get_problem(planner);
+  const bool useMax = heuristic == goap::PlanHeuristic::HMax;
+  auto combine = [&](float a, float b) { return useMax ? std::max(a, b) : a + b; };
+
+  struct Scratch
+  {
+    std::vector<size_t> missing; // preconditions not reached yet, per action
+    std::vector<float> base; // combined cost of reached preconditions
+    std::vector<std::pair<float, size_t>> open;
+    std::vector<std::vector<int>> settled; // per slot values with final costs, additive effects start from them
+  };
+  static thread_local Scratch s;
+  const size_t numSlots = p.slotAdders.size();
+  costs.assign(numSlots * facts_per_slot, unreachable);
+  s.open.clear();
+  s.settled.resize(numSlots);
+  for (std::vector<int> &values : s.settled)
+    values.clear();
+  auto relax = [&](size_t slot, int value, float cost)
+  {
+    const size_t fact = fact_id(slot, value);
+    if (cost >= costs[fact])
+      return;
+    costs[fact] = cost;
+    s.open.push_back({cost, fact});
+    std::push_heap(s.open.begin(), s.open.end(), std::greater<std::pair<float, size_t>>());
+  };
+  auto fire = [&](size_t a)
+  {
+    const RelaxedAction &action = p.actions[a];
+    for (size_t fact : action.sets)
+      relax(fact / facts_per_slot, int(int8_t(fact % facts_per_slot)), s.base[a] + action.cost);
+    // values that aren't settled yet are moved on from when they are
+    for (const auto &[slot, delta] : action.adds)
+      for (int v : s.settled[slot])
+        relax(slot, v + delta, combine(s.base[a], costs[fact_id(slot, v)]) + action.cost);
+  };
+
+  for (size_t i = 0; i < numSlots; ++i)
+    relax(i, from[i], 0.f);
+  s.missing.resize(p.actions.size());
+  s.base.assign(p.actions.size(), 0.f);
+  for (size_t a = 0; a < p.actions.size(); ++a)
+  {
+    s.missing[a] = p.actions[a].precond.size();
+    if (s.missing[a] == 0)
+      fire(a);
+  }
+  size_t goalsLeft = 0;
+  if (goal)
+    for (size_t i = 0; i < numSlots; ++i)
+      if ((*goal)[i] >= 0)
+        goalsLeft++;
+  while (!s.open.empty() && (!goal || goalsLeft > 0))
+  {
+    std::pop_heap(s.open.begin(), s.open.end(), std::greater<std::pair<float, size_t>>());
+    const auto [cost, fact] = s.open.back();
+    s.open.pop_back();
+    if (cost > costs[fact])
+      continue;
+    const size_t slot = fact / facts_per_slot;
+    const int value = int8_t(fact % facts_per_slot);
+    s.settled[slot].push_back(value);
+    if (goal && (*goal)[slot] >= 0 && (*goal)[slot] == value)
+      goalsLeft--;
+    for (size_t a : p.precondUsers[fact])
+    {
+      s.base[a] = combine(s.base[a], cost);
+      if (--s.missing[a] == 0)
+        fire(a);
+    }
+    // additive effects of already applicable actions move on from this value
+    for (size_t a : p.slotAdders[slot])
+      if (s.missing[a] == 0)
+        for (const auto &[addSlot, delta] : p.actions[a].adds)
+          if (addSlot == slot)
+            relax(slot, value + delta, combine(s.base[a], cost) + p.actions[a].cost);
+  }
+}
+
+void goap::relaxed_fact_costs(const Planner &planner, PlanHeuristic heuristic, const WorldState &from,
+                              std::vector<float> &costs)
+{
+  explore_facts(planner, heuristic, from, nullptr, costs);
+}
+
+float goap::relaxed_goal_cost(PlanHeuristic heuristic, const std::vector<float> &costs, const WorldState &goal)
+{
+  float res = 0.f;
+  for (size_t i = 0; i < goal.size(); ++i)
+    if (goal[i] >= 0)
+    {
+      const float cost = costs[fact_id(i, goal[i])];
+      res = heuristic == PlanHeuristic::HMax ? std::max(res, cost) : res + cost;
+    }
+  return res;
+}
+
+float goap::relaxed_heuristic(const Planner &planner, PlanHeuristic heuristic, const WorldState &from,
+                              const WorldState &goal)
+{
+  static thread_local std::vector<float> costs;
+  explore_facts(planner, heuristic, from, &goal, costs);
+  return relaxed_goal_cost(heuristic, costs, goal);
+}
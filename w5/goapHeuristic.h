@@ -0,0 +1,16 @@
+#pragma once
+#include "goapPlanner.h"
+
+namespace goap
+{
+  // relaxed planning: actions never undo facts, so every (slot, value) fact gets the cost of reaching it,
+  // h_max takes the most expensive precondition/goal fact and is admissible, h_add sums them
+  // facts are indexed as slot * 256 + uint8_t(value), unreachable ones cost +inf
+
+  // compiled problem is cached per thread and planner version
+  void relaxed_fact_costs(const Planner &planner, PlanHeuristic heuristic, const WorldState &from,
+                          std::vector<float> &costs);
+  float relaxed_goal_cost(PlanHeuristic heuristic, const std::vector<float> &costs, const WorldState &goal);
+  float relaxed_heuristic(const Planner &planner, PlanHeuristic heuristic, const WorldState &from, const WorldState &goal);
+};
+
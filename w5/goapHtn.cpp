@@ -0,0 +1,86 @@
+#include "goapHtn.h"
+
+goap::HtnDomain goap::create_htn_domain(const Planner &planner)
+{
+  HtnDomain domain;
+  for (size_t i = 0; i < planner.actions.size(); ++i)
+  {
+    domain.taskNames.emplace(planner.actions[i].name, domain.tasks.size());
+    domain.tasks.push_back({planner.actions[i].name, i, {}});
+  }
+  return domain;
+}
+
+size_t goap::add_htn_task(HtnDomain &domain, const char *name)
+{
+  auto [it, inserted] = domain.taskNames.emplace(name, domain.tasks.size());
+  if (inserted)
+    domain.tasks.push_back({name, size_t(-1), {}});
+  return it->second;
+}
+
+void goap::add_htn_method(HtnDomain &domain, const Planner &planner, const char *task, const char *name,
+                          const WorldStateList &precond, const std::vector<const char *> &subtasks)
+{
+  HtnMethod method;
+  method.name = name;
+  method.precondition = produce_planner_worldstate(planner, precond);
+  // subtasks can be declared after the method that uses them, recursion included
+  for (const char *subtask : subtasks)
+    method.subtasks.push_back(add_htn_task(domain, subtask));
+  domain.tasks[add_htn_task(domain, task)].methods.push_back(method);
+}
+
+struct HtnContext
+{
+  const goap::HtnDomain &domain;
+  const goap::Planner &planner;
+  std::vector<goap::PlanStep> &plan;
+  size_t maxDepth;
+};
+
+// on failure state and plan are left as they were
+static bool decompose(const HtnContext &ctx, size_t task_id, goap::WorldState &st, float &cost, size_t depth)
+{
+  const goap::HtnTask &task = ctx.domain.tasks[task_id];
+  if (task.action != size_t(-1))
+  {
+    if (!goap::is_action_valid(ctx.planner, task.action, st))
+      return false;
+    st = goap::apply_action(ctx.planner, task.action, st);
+    cost += goap::get_action_cost(ctx.planner, task.action);
+    ctx.plan.push_back({task.action, st});
+    return true;
+  }
+  if (depth >= ctx.maxDepth)
+    return false;
+  for (const goap::HtnMethod &method : task.methods)
+  {
+    if (goap::worldstate_distance(st, method.precondition) != 0)
+      continue;
+    const goap::WorldState prevState = st;
+    const float prevCost = cost;
+    const size_t prevSize = ctx.plan.size();
+    bool decomposed = true;
+    for (size_t i = 0; i < method.subtasks.size() && decomposed; ++i)
+      decomposed = decompose(ctx, method.subtasks[i], st, cost, depth + 1);
+    if (decomposed)
+      return true;
+    st = prevState;
+    cost = prevCost;
+    ctx.plan.resize(prevSize);
+  }
+  return false;
+}
+
+float goap::make_htn_plan(const HtnDomain &domain, const Planner &planner, const char *task, const WorldState &from,
+                          std::vector<PlanStep> &plan, size_t max_depth)
+{
+  auto itf = domain.taskNames.find(task);
+  if (itf == domain.taskNames.end())
+    return 0.f; // TODO: Assert
+  WorldState st = from;
+  float cost = 0.f;
+  decompose({domain, planner, plan, max_depth}, itf->second, st, cost, 0);
+  return cost;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "goapPlanner.h"
+
+namespace goap
+{
+  // hierarchical task network over planner's actions: compound tasks are decomposed by the first method
+  // whose precondition holds and whose subtasks all decompose, primitive tasks are planner's actions
+  struct HtnMethod
+  {
+    std::string name;
+    WorldState precondition; // -1 - don't care
+    std::vector<size_t> subtasks;
+  };
+
+  struct HtnTask
+  {
+    std::string name;
+    size_t action = size_t(-1); // planner action for primitive tasks
+    std::vector<HtnMethod> methods; // tried in order for compound ones
+  };
+
+  struct HtnDomain
+  {
+    std::vector<HtnTask> tasks;
+    std::unordered_map<std::string, size_t> taskNames;
+  };
+
+  // every action of the planner becomes a primitive task with the same name
+  HtnDomain create_htn_domain(const Planner &planner);
+  size_t add_htn_task(HtnDomain &domain, const char *name);
+  void add_htn_method(HtnDomain &domain, const Planner &planner, const char *task, const char *name,
+                      const WorldStateList &precond, const std::vector<const char *> &subtasks);
+
+  // depth is the number of nested decompositions, which also bounds recursive tasks
+  float make_htn_plan(const HtnDomain &domain, const Planner &planner, const char *task, const WorldState &from,
+                      std::vector<PlanStep> &plan, size_t max_depth = 64);
+};
+
@@ -1,85 +1,355 @@
 #include "goapPlanner.h"
+#include "goapPlanCache.h"
+#include "goapHeuristic.h"
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <span>
 
 struct PlanNode
 {
-  goap::WorldState worldState;
-  goap::WorldState prevState;
-
   float g = 0;
   float h = 0;
 
   size_t actionId;
+  size_t parent; // index in the node list, size_t(-1) for the start node
+  bool closed = false;
+};
+
+struct OpenEntry
+{
+  float f;
+  size_t node;
+
+  // heap functions build a max-heap, so the "greater" entry is the one with lower f
+  bool operator<(const OpenEntry &rhs) const { return f > rhs.f || (f == rhs.f && node > rhs.node); }
 };
 
-static float heuristic(const goap::WorldState &from, const goap::WorldState &to)
+// everything a search allocates, only cleared between searches so that it keeps its capacity
+struct goap::PlanArena
 {
-  float cost = 0;
-  for (size_t i = 0; i < to.size(); ++i)
-    if (to[i] >= 0) // we care about it
-      cost += float(abs(to[i] - from[i]));
-  return cost;
+  std::vector<PlanNode> nodes;
+  std::vector<goap::WorldState> states; // interned, node i owns states[i]
+  std::vector<size_t> hashes;
+  std::vector<size_t> table; // open addressing with linear probing, node index or size_t(-1) for empty
+  std::vector<OpenEntry> openList;
+  std::vector<size_t> transitions;
+  std::vector<float> factCosts; // relaxed costs from the start for regressive search
+};
+
+using goap::PlanArena;
+
+void goap::PlanArenaDeleter::operator()(PlanArena *arena) const
+{
+  delete arena;
 }
 
-static void reconstruct_plan(PlanNode &goal_node, const std::vector<PlanNode> &closed, std::vector<goap::PlanStep> &plan)
+std::unique_ptr<PlanArena, goap::PlanArenaDeleter> goap::create_plan_arena()
 {
-  PlanNode &curNode = goal_node;
-  while (curNode.actionId != size_t(-1))
+  return std::unique_ptr<PlanArena, PlanArenaDeleter>(new PlanArena());
+}
+
+// make_plan runs to completion, so it can reuse one arena per thread
+static thread_local PlanArena threadArena;
+
+static void clear_arena(PlanArena &a)
+{
+  a.nodes.clear();
+  a.states.clear();
+  a.hashes.clear();
+  if (a.table.empty())
+    a.table.resize(256);
+  std::fill(a.table.begin(), a.table.end(), size_t(-1));
+  a.openList.clear();
+}
+
+static void grow_table(PlanArena &a)
+{
+  a.table.assign(a.table.size() * 2, size_t(-1));
+  const size_t mask = a.table.size() - 1;
+  for (size_t node = 0; node < a.hashes.size(); ++node)
   {
-    plan.push_back({curNode.actionId, curNode.worldState});
-    auto itf = std::find_if(closed.begin(), closed.end(), [&](const PlanNode &n) { return n.worldState == curNode.prevState; });
-    curNode = *itf;
+    size_t slot = a.hashes[node] & mask;
+    while (a.table[slot] != size_t(-1))
+      slot = (slot + 1) & mask;
+    a.table[slot] = node;
   }
-  std::reverse(plan.begin(), plan.end());
 }
 
-float goap::make_plan(const Planner &planner, const WorldState &from, const WorldState &to, std::vector<PlanStep> &plan)
+// returns node index of the state, adding a node for it if it wasn't seen in this search yet
+static std::pair<size_t, bool> intern_state(PlanArena &a, const goap::WorldState &st)
 {
-  std::vector<PlanNode> openList = {PlanNode{from, from, 0, heuristic(from, to), size_t(-1)}};
-  std::vector<PlanNode> closedList = {};
-  while (!openList.empty())
+  if (a.states.size() * 2 >= a.table.size())
+    grow_table(a);
+  const size_t hash = goap::hash_worldstate(st);
+  const size_t mask = a.table.size() - 1;
+  size_t slot = hash & mask;
+  for (; a.table[slot] != size_t(-1); slot = (slot + 1) & mask)
   {
-    auto minIt = openList.begin();
-    float minF = minIt->g + minIt->h;
-    for (auto it = openList.begin(); it != openList.end(); ++it)
-      if (it->g + it->h < minF)
-      {
-        minF = it->g + it->h;
-        minIt = it;
-      }
-    PlanNode cur = *minIt;
-    openList.erase(minIt);
-    if (heuristic(cur.worldState, to) == 0) // we've reached our goal
-    {
-      reconstruct_plan(cur, closedList, plan);
-      return minF;
-    }
-    closedList.push_back(cur);
-    std::vector<size_t> transitions = find_valid_state_transitions(planner, cur.worldState);
-    //const bool firstIter = openList.empty();
-    //printf("------------\n");
-    for (size_t actId : transitions)
+    const size_t node = a.table[slot];
+    if (a.hashes[node] == hash && a.states[node] == st)
+      return {node, false};
+  }
+  a.table[slot] = a.states.size();
+  a.states.push_back(st);
+  a.hashes.push_back(hash);
+  a.nodes.emplace_back();
+  return {a.states.size() - 1, true};
+}
+
+static void push_open(PlanArena &a, float f, size_t node)
+{
+  a.openList.push_back({f, node});
+  std::push_heap(a.openList.begin(), a.openList.end());
+}
+
+constexpr size_t search_failed = size_t(-1);
+constexpr size_t search_paused = size_t(-2);
+
+template<typename Heuristic>
+static void init_search(PlanArena &a, const goap::WorldState &start, const Heuristic &heuristic)
+{
+  clear_arena(a);
+  intern_state(a, start);
+  a.nodes[0] = {0, heuristic(start), size_t(-1), size_t(-1)};
+  push_open(a, a.nodes[0].h, 0);
+}
+
+// A* over the arena, returns index of the first goal node, search_failed or search_paused
+// expand(state, add) has to call add(action, cost, successor) for every successor of the state,
+// successors with infinite heuristic are known to be dead ends and are never opened
+template<typename Heuristic, typename IsGoal, typename Expand>
+static size_t step_search(PlanArena &a, const Heuristic &heuristic, const IsGoal &is_goal, const Expand &expand,
+                          const goap::PlanBudget &budget, goap::PlanStats &stats, size_t &best_node)
+{
+  const auto start = std::chrono::steady_clock::now();
+  size_t expanded = 0;
+  // decrease-key is done lazily: a better path pushes a new entry and the stale one is skipped when popped
+  while (!a.openList.empty())
+  {
+    if (budget.maxNodes > 0 && expanded >= budget.maxNodes)
+      return search_paused;
+    // clock isn't free, so it's only checked every few nodes
+    if (budget.maxMicroseconds > 0.f && expanded % 16 == 15 &&
+        std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count() >= budget.maxMicroseconds)
+      return search_paused;
+    std::pop_heap(a.openList.begin(), a.openList.end());
+    const OpenEntry top = a.openList.back();
+    a.openList.pop_back();
+    PlanNode &cur = a.nodes[top.node];
+    if (cur.closed || top.f > cur.g + cur.h)
+      continue;
+    if (is_goal(a.states[top.node])) // we've reached our goal
+      return top.node;
+    cur.closed = true;
+    expanded++;
+    stats.nodesExpanded++;
+    const float curG = cur.g;
+    // successors are interned while expanding, so the state is copied out of the arena first
+    const goap::WorldState curState = a.states[top.node];
+    expand(curState, [&](size_t act_id, float cost, const goap::WorldState &st)
     {
-      //printf("valid action: %s\n", planner.actions[actId].name.c_str());
-      WorldState st = apply_action(planner, actId, cur.worldState);
-      const float score = cur.g + get_action_cost(planner, actId);
-      auto openIt = std::find_if(openList.begin(), openList.end(), [&](const PlanNode &n) { return st == n.worldState; });
-      auto closeIt = std::find_if(closedList.begin(), closedList.end(), [&](const PlanNode &n) { return st == n.worldState; });
-      if (openIt != openList.end() && score < openIt->g)
+      const float score = curG + cost;
+      const auto [nodeId, inserted] = intern_state(a, st);
+      PlanNode &next = a.nodes[nodeId];
+      if (inserted)
       {
-        openIt->g = score;
-        openIt->prevState = cur.worldState;
+        stats.nodesGenerated++;
+        next = {score, heuristic(st), act_id, top.node};
       }
-      if (closeIt != closedList.end() && score < closeIt->g)
+      else if (score < next.g)
       {
-        closeIt->g = score;
-        closeIt->prevState = cur.worldState;
+        // the heuristic isn't consistent with additive effects, so closed nodes are reopened on a better path
+        next.g = score;
+        next.actionId = act_id;
+        next.parent = top.node;
+        next.closed = false;
       }
-      if (closeIt == closedList.end() && openIt == openList.end())
-        openList.push_back({st, cur.worldState, score, heuristic(st, to), actId});
-    }
+      else
+        return;
+      if (std::isinf(next.h))
+        return;
+      push_open(a, score + next.h, nodeId);
+      const PlanNode &best = a.nodes[best_node];
+      if (next.h < best.h || (next.h == best.h && next.g < best.g))
+        best_node = nodeId;
+    });
+  }
+  return search_failed;
+}
+
+// calls func(start, heuristic, is_goal, expand) for the search direction of the session
+// regressive search goes from the goal over partial states (-1 is "don't care") until one of them holds in from
+template<typename Func>
+static auto visit_search(const goap::PlanSession &session, const Func &func)
+{
+  const goap::Planner &planner = *session.planner;
+  PlanArena &a = *session.arena;
+  if (session.search == goap::PlanSearch::Regressive)
+  {
+    auto heuristic = [&](const goap::WorldState &st)
+    {
+      if (planner.heuristic == goap::PlanHeuristic::Distance)
+        return goap::worldstate_distance(session.from, st);
+      // relaxed costs from the start don't depend on the node, so they are computed once per search
+      return goap::relaxed_goal_cost(planner.heuristic, a.factCosts, st);
+    };
+    auto isGoal = [&](const goap::WorldState &st) { return goap::worldstate_distance(session.from, st) == 0; };
+    auto expand = [&](const goap::WorldState &st, const auto &add)
+    {
+      goap::WorldState regressed;
+      for (size_t actId = 0; actId < planner.actions.size(); ++actId)
+        if (goap::regress_action(planner, actId, st, regressed))
+          add(actId, goap::get_action_cost(planner, actId), regressed);
+    };
+    return func(session.to, heuristic, isGoal, expand);
   }
-  return 0.f;
+  auto heuristic = [&](const goap::WorldState &st)
+  {
+    if (planner.heuristic == goap::PlanHeuristic::Distance)
+      return goap::worldstate_distance(st, session.to);
+    return goap::relaxed_heuristic(planner, planner.heuristic, st, session.to);
+  };
+  auto isGoal = [&](const goap::WorldState &st) { return goap::worldstate_distance(st, session.to) == 0; };
+  auto expand = [&](const goap::WorldState &st, const auto &add)
+  {
+    goap::find_valid_state_transitions(planner, st, a.transitions);
+    for (size_t actId : a.transitions)
+      add(actId, goap::get_action_cost(planner, actId), goap::apply_action(planner, actId, st));
+  };
+  return func(session.from, heuristic, isGoal, expand);
+}
+
+static void reconstruct_forward(const PlanArena &a, size_t node, std::vector<goap::PlanStep> &plan)
+{
+  const size_t first = plan.size();
+  for (size_t cur = node; a.nodes[cur].parent != size_t(-1); cur = a.nodes[cur].parent)
+    plan.push_back({a.nodes[cur].actionId, a.states[cur]});
+  std::reverse(plan.begin() + ptrdiff_t(first), plan.end());
+}
+
+// parents lead towards the goal, so they are already in execution order, states are filled by replaying the plan
+static void reconstruct_regressive(const goap::PlanSession &session, size_t node, std::vector<goap::PlanStep> &plan)
+{
+  const PlanArena &a = *session.arena;
+  goap::WorldState st = session.from;
+  for (size_t cur = node; a.nodes[cur].parent != size_t(-1); cur = a.nodes[cur].parent)
+  {
+    st = goap::apply_action(*session.planner, a.nodes[cur].actionId, st);
+    plan.push_back({a.nodes[cur].actionId, st});
+  }
+}
+
+// a cache hit is appended to plan and finishes the session right away
+static void begin_session(goap::PlanSession &session, const goap::Planner &planner, const goap::WorldState &from,
+                          const goap::WorldState &to, std::vector<goap::PlanStep> &plan)
+{
+  session.planner = &planner;
+  session.plannerVersion = planner.version;
+  session.search = planner.search;
+  session.from = from;
+  session.to = to;
+  session.stats = {};
+  session.cost = 0.f;
+  session.bestNode = 0;
+  const size_t first = plan.size();
+  if (goap::find_cached_plan(planner, from, to, plan, session.cost))
+  {
+    // failures are cached as empty plans too
+    const bool found = plan.size() > first || goap::worldstate_distance(from, to) == 0;
+    session.status = found ? goap::PlanStatus::Found : goap::PlanStatus::Failed;
+    return;
+  }
+  session.status = goap::PlanStatus::Searching;
+  if (planner.search == goap::PlanSearch::Regressive && planner.heuristic != goap::PlanHeuristic::Distance)
+    goap::relaxed_fact_costs(planner, planner.heuristic, from, session.arena->factCosts);
+  visit_search(session, [&](const goap::WorldState &start, const auto &heuristic, const auto &, const auto &)
+  {
+    init_search(*session.arena, start, heuristic);
+  });
+}
+
+// the plan is appended to plan once the search is over
+static goap::PlanStatus run_session(goap::PlanSession &session, const goap::PlanBudget &budget,
+                                    std::vector<goap::PlanStep> &plan)
+{
+  const size_t res = visit_search(session,
+    [&](const goap::WorldState &, const auto &heuristic, const auto &is_goal, const auto &expand)
+  {
+    return step_search(*session.arena, heuristic, is_goal, expand, budget, session.stats, session.bestNode);
+  });
+  if (res == search_paused)
+    return session.status;
+  const size_t first = plan.size();
+  if (res == search_failed)
+    session.status = goap::PlanStatus::Failed;
+  else
+  {
+    session.status = goap::PlanStatus::Found;
+    session.cost = session.arena->nodes[res].g;
+    if (session.search == goap::PlanSearch::Regressive)
+      reconstruct_regressive(session, res, plan);
+    else
+      reconstruct_forward(*session.arena, res, plan);
+  }
+  goap::store_cached_plan(*session.planner, session.from, session.to,
+                          std::span<const goap::PlanStep>(plan).subspan(first), session.cost);
+  return session.status;
+}
+
+goap::PlanSession goap::start_plan_session(const Planner &planner, const WorldState &from, const WorldState &to)
+{
+  PlanSession session;
+  session.ownedArena = create_plan_arena();
+  session.arena = session.ownedArena.get();
+  begin_session(session, planner, from, to, session.plan);
+  return session;
+}
+
+goap::PlanStatus goap::continue_plan_session(PlanSession &session, const PlanBudget &budget)
+{
+  if (session.planner->version != session.plannerVersion)
+  {
+    session.plan.clear();
+    begin_session(session, *session.planner, session.from, session.to, session.plan);
+  }
+  if (session.status != PlanStatus::Searching)
+    return session.status;
+  return run_session(session, budget, session.plan);
+}
+
+float goap::get_session_plan(const PlanSession &session, std::vector<PlanStep> &plan)
+{
+  if (session.status == PlanStatus::Found)
+  {
+    plan.insert(plan.end(), session.plan.begin(), session.plan.end());
+    return session.cost;
+  }
+  if (session.search != PlanSearch::Forward || session.arena == nullptr || session.arena->nodes.empty())
+    return 0.f;
+  reconstruct_forward(*session.arena, session.bestNode, plan);
+  return session.arena->nodes[session.bestNode].g;
+}
+
+float goap::make_plan(const Planner &planner, const WorldState &from, const WorldState &to, std::vector<PlanStep> &plan,
+                      PlanStats *stats)
+{
+  return make_plan(planner, threadArena, from, to, plan, stats);
+}
+
+// same steps as a session, but the plan goes straight to the caller, so nothing is allocated on a warm arena
+float goap::make_plan(const Planner &planner, PlanArena &arena, const WorldState &from, const WorldState &to,
+                      std::vector<PlanStep> &plan, PlanStats *stats)
+{
+  PlanSession session;
+  session.arena = &arena;
+  begin_session(session, planner, from, to, plan);
+  if (session.status == PlanStatus::Searching)
+    run_session(session, {}, plan);
+  if (stats)
+    *stats = session.stats;
+  return session.cost;
 }
 
 void goap::print_plan(const Planner &planner, const WorldState &init, const std::vector<PlanStep> &plan)
@@ -0,0 +1,39 @@
+#include "goapPlanBatch.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <future>
+#include <thread>
+
+void goap::make_plans(const Planner &planner, PlanWorkers &workers, std::span<const PlanRequest> requests,
+                      std::span<PlanResult> results, size_t num_workers)
+{
+  assert(results.size() >= requests.size());
+  if (num_workers == 0)
+    num_workers = std::max(size_t(std::thread::hardware_concurrency()), size_t(1));
+  num_workers = std::max(std::min(num_workers, requests.size()), size_t(1));
+  while (workers.arenas.size() < num_workers)
+    workers.arenas.push_back(create_plan_arena());
+
+  // workers grab requests one by one, each of them plans on its own arena
+  std::atomic<size_t> next = 0;
+  auto worker = [&](PlanArena &arena)
+  {
+    for (size_t i = next++; i < requests.size(); i = next++)
+    {
+      PlanResult &res = results[i];
+      res.agent = requests[i].agent;
+      res.plan.clear();
+      res.stats = {};
+      res.cost = make_plan(planner, arena, requests[i].from, requests[i].to, res.plan, &res.stats);
+    }
+  };
+  std::vector<std::future<void>> threads;
+  for (size_t i = 1; i < num_workers; ++i)
+    threads.push_back(std::async(std::launch::async, worker, std::ref(*workers.arenas[i])));
+  // calling thread takes part as well
+  worker(*workers.arenas[0]);
+  for (std::future<void> &w : threads)
+    w.get();
+}
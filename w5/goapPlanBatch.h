@@ -0,0 +1,34 @@
+#pragma once
+#include <span>
+#include "goapPlanner.h"
+
+namespace goap
+{
+  struct PlanRequest
+  {
+    size_t agent; // caller's id, passed through to the result
+    WorldState from;
+    WorldState to;
+  };
+
+  struct PlanResult
+  {
+    size_t agent = 0;
+    std::vector<PlanStep> plan;
+    float cost = 0.f;
+    PlanStats stats;
+  };
+
+  // search storage of each worker, kept by the caller between batches, so they don't allocate it every time
+  struct PlanWorkers
+  {
+    std::vector<std::unique_ptr<PlanArena, PlanArenaDeleter>> arenas;
+  };
+
+  // plans all requests on worker threads against one planner, which must not change until this returns,
+  // results[i] is always the plan for requests[i], so applying them in order doesn't depend on scheduling
+  // num_workers = 0 uses all hardware threads
+  void make_plans(const Planner &planner, PlanWorkers &workers, std::span<const PlanRequest> requests,
+                  std::span<PlanResult> results, size_t num_workers = 0);
+};
+
@@ -0,0 +1,100 @@
+#include "goapPlanCache.h"
+#include <deque>
+#include <mutex>
+
+constexpr size_t plan_cache_capacity = 1024;
+constexpr size_t plan_cache_shards = 16;
+
+struct PlanCacheKey
+{
+  uint64_t version;
+  size_t fromHash;
+  size_t toHash;
+
+  bool operator==(const PlanCacheKey &) const = default;
+};
+
+struct PlanCacheKeyHash
+{
+  size_t operator()(const PlanCacheKey &key) const
+  {
+    size_t hash = key.version * 0x9e3779b97f4a7c15ull;
+    hash = (hash ^ key.fromHash) * 0x9e3779b97f4a7c15ull;
+    return hash ^ (key.toHash + (hash >> 29));
+  }
+};
+
+struct CachedPlan
+{
+  goap::WorldState from;
+  goap::WorldState to;
+  std::vector<goap::PlanStep> plan;
+  float cost;
+};
+
+struct PlanCacheShard
+{
+  std::mutex mutex;
+  std::unordered_map<PlanCacheKey, CachedPlan, PlanCacheKeyHash> plans;
+  std::deque<PlanCacheKey> insertionOrder; // oldest entries are evicted first
+};
+
+static PlanCacheShard shards[plan_cache_shards];
+
+static PlanCacheKey make_key(const goap::Planner &planner, const goap::WorldState &from, const goap::WorldState &to)
+{
+  return {planner.version, goap::hash_worldstate(from), goap::hash_worldstate(to)};
+}
+
+static PlanCacheShard &get_shard(const PlanCacheKey &key)
+{
+  return shards[(PlanCacheKeyHash()(key) >> 32) % plan_cache_shards];
+}
+
+bool goap::find_cached_plan(const Planner &planner, const WorldState &from, const WorldState &to,
+                            std::vector<PlanStep> &plan, float &cost)
+{
+  if (!planner.cachePlans)
+    return false;
+  const PlanCacheKey key = make_key(planner, from, to);
+  PlanCacheShard &shard = get_shard(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto itf = shard.plans.find(key);
+  // hashes can collide, so hit has to be for the very same states
+  if (itf == shard.plans.end() || !(itf->second.from == from) || !(itf->second.to == to))
+    return false;
+  plan.insert(plan.end(), itf->second.plan.begin(), itf->second.plan.end());
+  cost = itf->second.cost;
+  return true;
+}
+
+void goap::store_cached_plan(const Planner &planner, const WorldState &from, const WorldState &to,
+                             std::span<const PlanStep> plan, float cost)
+{
+  if (!planner.cachePlans)
+    return;
+  const PlanCacheKey key = make_key(planner, from, to);
+  PlanCacheShard &shard = get_shard(key);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  // entry is filled only when it's new, so storing a plan that is already there doesn't copy it
+  auto [it, inserted] = shard.plans.try_emplace(key);
+  if (!inserted)
+    return;
+  it->second = {from, to, {plan.begin(), plan.end()}, cost};
+  shard.insertionOrder.push_back(key);
+  if (shard.insertionOrder.size() > plan_cache_capacity / plan_cache_shards)
+  {
+    shard.plans.erase(shard.insertionOrder.front());
+    shard.insertionOrder.pop_front();
+  }
+}
+
+void goap::clear_plan_cache()
+{
+  for (PlanCacheShard &shard : shards)
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.plans.clear();
+    shard.insertionOrder.clear();
+  }
+}
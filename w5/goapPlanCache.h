@@ -0,0 +1,16 @@
+#pragma once
+#include <span>
+#include "goapPlanner.h"
+
+namespace goap
+{
+  // bounded cache shared by all threads, keyed by (planner version, from, goal), used only by planners
+  // that enabled it with set_planner_plan_cache, split into shards so parallel planning rarely waits on a lock
+  // plans that weren't found are cached as well, as an empty plan with zero cost
+  bool find_cached_plan(const Planner &planner, const WorldState &from, const WorldState &to,
+                        std::vector<PlanStep> &plan, float &cost);
+  void store_cached_plan(const Planner &planner, const WorldState &from, const WorldState &to,
+                         std::span<const PlanStep> plan, float cost);
+  void clear_plan_cache();
+};
+
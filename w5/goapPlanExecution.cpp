@@ -0,0 +1,92 @@
+#include "goapPlanExecution.h"
+
+// false if some step can't be regressed, then there's nothing to monitor the plan against,
+// requirements are dropped and the execution is marked to be planned from scratch on the next update
+static bool update_requirements(goap::PlanExecution &exec, const goap::Planner &planner)
+{
+  exec.required.resize(exec.plan.size() + 1);
+  exec.required.back() = exec.goal;
+  for (size_t i = exec.plan.size(); i > 0; --i)
+    if (!goap::regress_action(planner, exec.plan[i - 1].action, exec.required[i], exec.required[i - 1], false))
+    {
+      exec.required.clear();
+      exec.plannerVersion = 0; // versions start from 1
+      return false;
+    }
+  exec.plannerVersion = planner.version;
+  return true;
+}
+
+static void update_predictions(goap::PlanExecution &exec, const goap::Planner &planner, const goap::WorldState &from)
+{
+  goap::WorldState st = from;
+  for (goap::PlanStep &step : exec.plan)
+    step.worldState = st = goap::apply_action(planner, step.action, st);
+}
+
+static bool replan(goap::PlanExecution &exec, const goap::Planner &planner, const goap::WorldState &from)
+{
+  exec.plan.clear();
+  goap::make_plan(planner, from, exec.goal, exec.plan);
+  return update_requirements(exec, planner);
+}
+
+void goap::start_plan_execution(PlanExecution &exec, const Planner &planner, const WorldState &from, const WorldState &goal)
+{
+  exec.goal = goal;
+  replan(exec, planner, from);
+}
+
+size_t goap::update_plan_execution(PlanExecution &exec, const Planner &planner, const WorldState &sensed)
+{
+  if (exec.plannerVersion != planner.version)
+  {
+    exec.replans++;
+    // fresh plan that can't be monitored is followed blindly for this turn
+    if (!replan(exec, planner, sensed))
+      return exec.plan.empty() ? size_t(-1) : exec.plan.front().action;
+  }
+
+  // the latest step that can still be followed from here, steps before it are either done or not needed anymore
+  size_t closest = exec.required.size() - 1;
+  float closestDist = worldstate_distance(sensed, exec.required[closest]);
+  for (size_t i = exec.required.size(); i-- > 0;)
+  {
+    const float dist = worldstate_distance(sensed, exec.required[i]);
+    if (dist == 0)
+    {
+      exec.plan.erase(exec.plan.begin(), exec.plan.begin() + ptrdiff_t(i));
+      exec.required.erase(exec.required.begin(), exec.required.begin() + ptrdiff_t(i));
+      update_predictions(exec, planner, sensed);
+      return exec.plan.empty() ? size_t(-1) : exec.plan.front().action;
+    }
+    if (dist < closestDist)
+    {
+      closest = i;
+      closestDist = dist;
+    }
+  }
+
+  // diverged, so plan the way back onto the closest suffix of the old plan and keep the rest of it
+  std::vector<PlanStep> patch;
+  if (closest + 1 < exec.required.size())
+  {
+    PlanSession session = start_plan_session(planner, sensed, exec.required[closest]);
+    if (continue_plan_session(session, exec.repairBudget) == PlanStatus::Found)
+      get_session_plan(session, patch);
+  }
+  if (!patch.empty())
+  {
+    exec.plan.erase(exec.plan.begin(), exec.plan.begin() + ptrdiff_t(closest));
+    exec.plan.insert(exec.plan.begin(), patch.begin(), patch.end());
+    if (update_requirements(exec, planner))
+    {
+      exec.repairs++;
+      update_predictions(exec, planner, sensed);
+      return exec.plan.front().action;
+    }
+  }
+  exec.replans++;
+  replan(exec, planner, sensed);
+  return exec.plan.empty() ? size_t(-1) : exec.plan.front().action;
+}
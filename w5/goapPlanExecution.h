@@ -0,0 +1,24 @@
+#pragma once
+#include "goapPlanner.h"
+
+namespace goap
+{
+  // plan that is being followed by an agent, checked against the sensed state every turn
+  struct PlanExecution
+  {
+    WorldState goal;
+    std::vector<PlanStep> plan; // remaining steps with the state predicted after each of them
+    // required[i] is what has to hold for plan[i..] to still reach the goal, required[plan.size()] is the goal
+    std::vector<WorldState> required;
+    uint64_t plannerVersion = 0;
+
+    PlanBudget repairBudget = {256, 0.f}; // for planning the way back onto the old plan
+    size_t repairs = 0; // rest of the plan was kept, only the way back onto it was planned
+    size_t replans = 0; // planned from scratch
+  };
+
+  void start_plan_execution(PlanExecution &exec, const Planner &planner, const WorldState &from, const WorldState &goal);
+  // returns next action to do, or size_t(-1) when the goal is reached or can't be
+  size_t update_plan_execution(PlanExecution &exec, const Planner &planner, const WorldState &sensed);
+};
+
@@ -1,17 +1,91 @@
 #include "goapPlanner.h"
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GOAP_PLANNER_SSE 1
+#else
+#define GOAP_PLANNER_SSE 0
+#endif
+
+static std::atomic<uint64_t> plannerVersion = 0;
+
+// cached plans are keyed by version, so any change to the planner makes old entries unreachable
+static void touch_planner(goap::Planner &planner)
+{
+  planner.version = ++plannerVersion;
+}
 
 goap::Planner goap::create_planner()
 {
-  return Planner();
+  Planner res;
+  touch_planner(res);
+  return res;
+}
+
+void goap::set_planner_search(Planner &planner, PlanSearch search)
+{
+  planner.search = search;
+  touch_planner(planner);
+}
+
+void goap::set_planner_heuristic(Planner &planner, PlanHeuristic heuristic)
+{
+  planner.heuristic = heuristic;
+  touch_planner(planner);
+}
+
+void goap::set_planner_plan_cache(Planner &planner, bool enabled)
+{
+  planner.cachePlans = enabled;
 }
 
 void goap::add_states_to_planner(Planner &planner, const std::vector<std::string> &state_names)
 {
   for (const std::string &name : state_names)
-    planner.wdesc.emplace(name, planner.wdesc.size());
+  {
+    // states past the capacity of WorldState can't be stored, so they are rejected as unknown ones
+    const bool full = planner.wdesc.size() >= max_world_state_size;
+    assert(!full || planner.wdesc.count(name));
+    if (!full)
+      planner.wdesc.emplace(name, planner.wdesc.size());
+  }
+  touch_planner(planner);
 }
 
 
+static void build_pivot_index(goap::Planner &planner)
+{
+  std::vector<size_t> checks(planner.wdesc.size(), 0);
+  for (const goap::Action &action : planner.actions)
+    for (size_t i = 0; i < action.precondition.size(); ++i)
+      if (action.precondition[i] >= 0)
+        checks[i]++;
+  planner.pivotSlot = size_t(-1);
+  planner.pivotFree.clear();
+  planner.pivotBuckets.clear();
+  size_t maxChecks = 0;
+  for (size_t i = 0; i < checks.size(); ++i)
+    if (checks[i] > maxChecks)
+    {
+      maxChecks = checks[i];
+      planner.pivotSlot = i;
+    }
+  if (planner.pivotSlot == size_t(-1))
+    return;
+  planner.pivotBuckets.resize(256);
+  for (size_t i = 0; i < planner.actions.size(); ++i)
+  {
+    const int8_t val = planner.actions[i].precondition[planner.pivotSlot];
+    if (val < 0)
+      planner.pivotFree.push_back(i);
+    else
+      planner.pivotBuckets[uint8_t(val)].push_back(i);
+  }
+}
+
 void goap::add_action_to_planner(Planner &planner, const char *name, float cost, const Precond &precond,
                                                                                  const Effect &effect,
                                                                                  const Effect &additive_effect)
@@ -26,6 +100,8 @@ void goap::add_action_to_planner(Planner &planner, const char *name, float cost,
 
   planner.actionNames.emplace(name, planner.actions.size());
   planner.actions.emplace_back(act);
+  build_pivot_index(planner);
+  touch_planner(planner);
 }
 
 static void set_planner_worldstate(const goap::Planner &planner, goap::WorldState &st, const char *st_name, int8_t val)
@@ -51,33 +127,131 @@ float goap::get_action_cost(const Planner &planner, size_t act_id)
   return planner.actions[act_id].cost;
 }
 
+#if GOAP_PLANNER_SSE
+
+static __m128i load_lanes(const int8_t *values, size_t offset)
+{
+  return _mm_load_si128(reinterpret_cast<const __m128i *>(values + offset));
+}
+
+static bool matches_precondition(const goap::Action &action, const goap::WorldState &from)
+{
+  int eq = 0xffff;
+  for (size_t i = 0; i < goap::max_world_state_size; i += 16)
+  {
+    const __m128i checked = _mm_and_si128(load_lanes(from.values, i), load_lanes(action.care.values, i));
+    eq &= _mm_movemask_epi8(_mm_cmpeq_epi8(checked, load_lanes(action.precondValues.values, i)));
+  }
+  return eq == 0xffff;
+}
+
+static void apply_action_masks(const goap::Action &action, goap::WorldState &st)
+{
+  for (size_t i = 0; i < goap::max_world_state_size; i += 16)
+  {
+    const __m128i kept = _mm_andnot_si128(load_lanes(action.setMask.values, i), load_lanes(st.values, i));
+    const __m128i set = _mm_or_si128(kept, load_lanes(action.setValues.values, i));
+    _mm_store_si128(reinterpret_cast<__m128i *>(st.values + i), _mm_add_epi8(set, load_lanes(action.addValues.values, i)));
+  }
+}
+
+#else
+
+static bool matches_precondition(const goap::Action &action, const goap::WorldState &from)
+{
+  for (size_t i = 0; i < goap::max_world_state_size; ++i)
+    if ((from.values[i] & action.care.values[i]) != action.precondValues.values[i])
+      return false;
+  return true;
+}
+
+static void apply_action_masks(const goap::Action &action, goap::WorldState &st)
+{
+  for (size_t i = 0; i < goap::max_world_state_size; ++i)
+    st.values[i] = int8_t(((st.values[i] & ~action.setMask.values[i]) | action.setValues.values[i]) + action.addValues.values[i]);
+}
+
+#endif
+
 std::vector<size_t> goap::find_valid_state_transitions(const Planner &planner, const WorldState &from)
 {
   std::vector<size_t> res;
+  find_valid_state_transitions(planner, from, res);
+  return res;
+}
 
-  for (size_t i = 0; i < planner.actions.size(); ++i)
+void goap::find_valid_state_transitions(const Planner &planner, const WorldState &from, std::vector<size_t> &res)
+{
+  res.clear();
+  if (planner.pivotSlot == size_t(-1))
   {
-    const Action &action = planner.actions[i];
-    bool isValidAction = true;
-    for (size_t j = 0; j < action.precondition.size() && isValidAction; ++j)
-      isValidAction &= action.precondition[j] < 0 || from[j] == action.precondition[j];
-    if (isValidAction)
-      res.emplace_back(i);
+    for (size_t i = 0; i < planner.actions.size(); ++i)
+      if (matches_precondition(planner.actions[i], from))
+        res.emplace_back(i);
+    return;
   }
-  return res;
+  // merge both candidate lists so actions still come in planner order
+  const std::vector<size_t> &free = planner.pivotFree;
+  const std::vector<size_t> &bucket = planner.pivotBuckets[uint8_t(from[planner.pivotSlot])];
+  size_t i = 0, j = 0;
+  while (i < free.size() || j < bucket.size())
+  {
+    const size_t act = j == bucket.size() || (i < free.size() && free[i] < bucket[j]) ? free[i++] : bucket[j++];
+    if (matches_precondition(planner.actions[act], from))
+      res.emplace_back(act);
+  }
+}
+
+bool goap::is_action_valid(const Planner &planner, size_t act, const WorldState &from)
+{
+  return matches_precondition(planner.actions[act], from);
 }
 
 goap::WorldState goap::apply_action(const Planner &planner, size_t act, const WorldState &from)
 {
   WorldState res = from;
+  apply_action_masks(planner.actions[act], res);
+  return res;
+}
+
+bool goap::regress_action(const Planner &planner, size_t act, const WorldState &goal, WorldState &res, bool only_relevant)
+{
   const Action &action = planner.actions[act];
-  for (size_t i = 0; i < action.effect.size(); ++i)
+  res = goal;
+  bool relevant = false;
+  for (size_t i = 0; i < goal.size(); ++i)
   {
+    if (goal[i] < 0)
+      continue;
+    const int8_t eff = action.effect[i];
     if (!action.setBitset[i])
-      res[i] += action.effect[i];
-    else if (action.effect[i] >= 0)
-      res[i] = action.effect[i];
+    {
+      if (eff == 0)
+        continue;
+      const int prev = goal[i] - eff;
+      if (prev < 0 || prev > INT8_MAX)
+        return false;
+      res[i] = int8_t(prev);
+      relevant = true;
+    }
+    else if (eff >= 0)
+    {
+      if (eff != goal[i])
+        return false;
+      res[i] = -1;
+      relevant = true;
+    }
   }
-  return res;
+  if (only_relevant && !relevant)
+    return false;
+  for (size_t i = 0; i < goal.size(); ++i)
+  {
+    const int8_t pre = action.precondition[i];
+    if (pre < 0)
+      continue;
+    if (res[i] >= 0 && res[i] != pre)
+      return false;
+    res[i] = pre;
+  }
+  return true;
 }
-
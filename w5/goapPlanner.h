@@ -1,4 +1,6 @@
 #pragma once
+#include <cstdint>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 #include <string>
@@ -9,14 +11,42 @@
 namespace goap
 {
 
+  enum class PlanSearch
+  {
+    Forward,
+    Regressive // backwards from the goal, only through actions that achieve some of it
+  };
+
+  enum class PlanHeuristic
+  {
+    Distance, // sum of differences on the goal slots
+    HMax, // relaxed planning, see goapHeuristic.h
+    HAdd
+  };
+
   struct Planner
   {
     WorldDesc wdesc;
     std::vector<Action> actions;
     std::unordered_map<std::string, size_t> actionNames;
+
+    // actions bucketed by the value of the slot most preconditions check, so that ones that can't apply are skipped
+    size_t pivotSlot = size_t(-1);
+    std::vector<size_t> pivotFree; // actions that don't check pivot slot
+    std::vector<std::vector<size_t>> pivotBuckets; // indexed by uint8_t(value)
+
+    PlanSearch search = PlanSearch::Forward;
+    PlanHeuristic heuristic = PlanHeuristic::Distance;
+    bool cachePlans = false; // see goapPlanCache.h
+
+    uint64_t version = 0; // unique across all planners, changes whenever states or actions are added
   };
 
   Planner create_planner();
+  void set_planner_search(Planner &planner, PlanSearch search);
+  void set_planner_heuristic(Planner &planner, PlanHeuristic heuristic);
+  // cached plans stay valid, as they are keyed by planner version
+  void set_planner_plan_cache(Planner &planner, bool enabled);
 
   using StateDesc = std::pair<const char*, int>;
   using Precond = std::vector<StateDesc>;
@@ -33,7 +63,14 @@ namespace goap
   float get_action_cost(const Planner &planner, size_t act_id);
 
   std::vector<size_t> find_valid_state_transitions(const Planner &planner, const WorldState &from);
+  // same as above, but reuses res storage
+  void find_valid_state_transitions(const Planner &planner, const WorldState &from, std::vector<size_t> &res);
+  bool is_action_valid(const Planner &planner, size_t act, const WorldState &from);
   WorldState apply_action(const Planner &planner, size_t act, const WorldState &from);
+  // partial state (-1 is "don't care") that has to hold before the action for goal to hold after it,
+  // false if the action contradicts the goal or, with only_relevant, doesn't achieve any of its slots
+  bool regress_action(const Planner &planner, size_t act, const WorldState &goal, WorldState &res,
+                      bool only_relevant = true);
 
   struct PlanStep
   {
@@ -41,7 +78,66 @@ namespace goap
     WorldState worldState;
   };
 
-  float make_plan(const Planner &planner, const WorldState &from, const WorldState &to, std::vector<PlanStep> &plan);
+  struct PlanStats
+  {
+    size_t nodesExpanded = 0;
+    size_t nodesGenerated = 0;
+  };
+
+  // storage of a search, kept between searches so that they don't allocate
+  struct PlanArena;
+  struct PlanArenaDeleter
+  {
+    void operator()(PlanArena *arena) const;
+  };
+  std::unique_ptr<PlanArena, PlanArenaDeleter> create_plan_arena();
+
+  // stats are zero when the plan comes from the cache
+  float make_plan(const Planner &planner, const WorldState &from, const WorldState &to, std::vector<PlanStep> &plan,
+                  PlanStats *stats = nullptr);
+  // same, but on the caller's arena instead of the one of the calling thread
+  float make_plan(const Planner &planner, PlanArena &arena, const WorldState &from, const WorldState &to,
+                  std::vector<PlanStep> &plan, PlanStats *stats = nullptr);
+
+  // search that can be spread over several turns, planner has to outlive the session
+  // and the search restarts by itself if the planner changes in between
+
+  enum class PlanStatus
+  {
+    Searching,
+    Found,
+    Failed
+  };
+
+  struct PlanBudget
+  {
+    size_t maxNodes = 0; // nodes expanded per call, 0 - unlimited
+    float maxMicroseconds = 0.f; // 0 - unlimited
+  };
+
+  struct PlanSession
+  {
+    const Planner *planner = nullptr;
+    uint64_t plannerVersion = 0;
+    PlanSearch search = PlanSearch::Forward;
+    WorldState from;
+    WorldState to;
+
+    PlanStatus status = PlanStatus::Failed;
+    PlanStats stats; // accumulated over all calls
+    std::vector<PlanStep> plan; // filled once found
+    float cost = 0.f;
+
+    size_t bestNode = 0; // node with the lowest heuristic so far
+    PlanArena *arena = nullptr;
+    std::unique_ptr<PlanArena, PlanArenaDeleter> ownedArena;
+  };
+
+  PlanSession start_plan_session(const Planner &planner, const WorldState &from, const WorldState &to);
+  PlanStatus continue_plan_session(PlanSession &session, const PlanBudget &budget);
+  // whole plan if it was found, otherwise the way to the state closest to the goal so far,
+  // which is only known for forward search as regressive one doesn't start from the current state
+  float get_session_plan(const PlanSession &session, std::vector<PlanStep> &plan);
   void print_plan(const Planner &planner, const WorldState &init, const std::vector<PlanStep> &plan);
 };
 
@@ -0,0 +1,243 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+#include "goapPlanner.h"
+
+// GOAP domains known at compile time: states are enumerators of an enum with a trailing Count,
+// actions are constexpr arrays, so the search is specialized for exact state width and action count
+namespace goap
+{
+  template<typename E>
+  constexpr size_t checked_static_width()
+  {
+    static_assert(size_t(E::Count) <= max_world_state_size, "static domain doesn't fit into WorldState");
+    return size_t(E::Count);
+  }
+
+  template<typename E>
+  constexpr size_t static_width = checked_static_width<E>();
+
+  template<typename E>
+  using StaticState = std::array<int8_t, static_width<E>>;
+
+  template<typename E>
+  using StaticStateList = std::initializer_list<std::pair<E, int>>;
+
+  template<typename E>
+  struct StaticAction
+  {
+    const char *name;
+    float cost;
+    StaticState<E> precondition; // -1 - don't care
+    StaticState<E> effect; // -1 - don't set
+    StaticState<E> additive; // 0 - no change
+  };
+
+  template<typename E, size_t A>
+  using StaticDomain = std::array<StaticAction<E>, A>;
+
+  template<typename E>
+  struct StaticPlanStep
+  {
+    size_t action;
+    StaticState<E> worldState;
+  };
+
+  template<typename E>
+  constexpr StaticState<E> static_state(StaticStateList<E> values, int8_t fill = -1)
+  {
+    StaticState<E> res;
+    res.fill(fill);
+    for (const std::pair<E, int> &v : values)
+      res[size_t(v.first)] = int8_t(v.second);
+    return res;
+  }
+
+  template<typename E>
+  constexpr StaticAction<E> static_action(const char *name, float cost, StaticStateList<E> precond,
+                                          StaticStateList<E> effect, StaticStateList<E> additive_effect)
+  {
+    return {name, cost, static_state<E>(precond), static_state<E>(effect), static_state<E>(additive_effect, 0)};
+  }
+
+  template<typename E>
+  constexpr bool static_action_valid(const StaticAction<E> &action, const StaticState<E> &st)
+  {
+    for (size_t i = 0; i < static_width<E>; ++i)
+      if (action.precondition[i] >= 0 && action.precondition[i] != st[i])
+        return false;
+    return true;
+  }
+
+  template<typename E>
+  constexpr StaticState<E> static_apply_action(const StaticAction<E> &action, const StaticState<E> &st)
+  {
+    StaticState<E> res = st;
+    for (size_t i = 0; i < static_width<E>; ++i)
+      res[i] = int8_t((action.effect[i] >= 0 ? action.effect[i] : res[i]) + action.additive[i]);
+    return res;
+  }
+
+  template<typename E>
+  constexpr float static_distance(const StaticState<E> &from, const StaticState<E> &to)
+  {
+    int cost = 0;
+    for (size_t i = 0; i < static_width<E>; ++i)
+      if (to[i] >= 0) // we care about it
+        cost += to[i] > from[i] ? to[i] - from[i] : from[i] - to[i];
+    return float(cost);
+  }
+
+  template<typename E>
+  struct StaticStateHash
+  {
+    size_t operator()(const StaticState<E> &st) const
+    {
+      size_t hash = 14695981039346656037ull;
+      for (int8_t v : st)
+        hash = (hash ^ uint8_t(v)) * 1099511628211ull;
+      return hash;
+    }
+  };
+
+  // same A* as make_plan (ties broken by node order, closed nodes reopened), so both give the same plans,
+  // storage is kept per thread and per domain type, so repeated plans don't allocate
+  template<typename E, size_t A>
+  float make_static_plan(const StaticDomain<E, A> &domain, const StaticState<E> &from, const StaticState<E> &to,
+                         std::vector<StaticPlanStep<E>> &plan)
+  {
+    struct Node
+    {
+      StaticState<E> state;
+      float g;
+      float h;
+      size_t action;
+      size_t parent;
+      bool closed;
+    };
+    using Entry = std::pair<float, size_t>; // f and node, greater<> makes it a min-heap
+    struct Storage
+    {
+      std::vector<Node> nodes;
+      std::vector<size_t> table; // open addressing, node index or size_t(-1)
+      std::vector<Entry> openList;
+    };
+    static thread_local Storage storage;
+    std::vector<Node> &nodes = storage.nodes;
+    std::vector<size_t> &table = storage.table;
+    std::vector<Entry> &openList = storage.openList;
+    nodes.clear();
+    openList.clear();
+    table.assign(std::max(table.size(), size_t(256)), size_t(-1));
+
+    // returns node index and whether it was just added
+    auto intern = [&](const StaticState<E> &st) -> std::pair<size_t, bool>
+    {
+      if (nodes.size() * 2 >= table.size())
+      {
+        table.assign(table.size() * 2, size_t(-1));
+        for (size_t n = 0; n < nodes.size(); ++n)
+        {
+          size_t slot = StaticStateHash<E>()(nodes[n].state) & (table.size() - 1);
+          while (table[slot] != size_t(-1))
+            slot = (slot + 1) & (table.size() - 1);
+          table[slot] = n;
+        }
+      }
+      size_t slot = StaticStateHash<E>()(st) & (table.size() - 1);
+      for (; table[slot] != size_t(-1); slot = (slot + 1) & (table.size() - 1))
+        if (nodes[table[slot]].state == st)
+          return {table[slot], false};
+      table[slot] = nodes.size();
+      nodes.push_back({st, 0.f, 0.f, size_t(-1), size_t(-1), false});
+      return {nodes.size() - 1, true};
+    };
+    auto push = [&](float f, size_t node)
+    {
+      openList.push_back({f, node});
+      std::push_heap(openList.begin(), openList.end(), std::greater<Entry>());
+    };
+
+    intern(from);
+    nodes[0].h = static_distance<E>(from, to);
+    push(nodes[0].h, 0);
+    while (!openList.empty())
+    {
+      std::pop_heap(openList.begin(), openList.end(), std::greater<Entry>());
+      const auto [f, cur] = openList.back();
+      openList.pop_back();
+      if (nodes[cur].closed || f > nodes[cur].g + nodes[cur].h)
+        continue;
+      if (nodes[cur].h == 0)
+      {
+        const size_t first = plan.size();
+        for (size_t n = cur; nodes[n].parent != size_t(-1); n = nodes[n].parent)
+          plan.push_back({nodes[n].action, nodes[n].state});
+        std::reverse(plan.begin() + ptrdiff_t(first), plan.end());
+        return nodes[cur].g;
+      }
+      nodes[cur].closed = true;
+      const StaticState<E> curState = nodes[cur].state;
+      const float curG = nodes[cur].g;
+      for (size_t act = 0; act < A; ++act)
+      {
+        if (!static_action_valid<E>(domain[act], curState))
+          continue;
+        const StaticState<E> st = static_apply_action<E>(domain[act], curState);
+        const float score = curG + domain[act].cost;
+        const auto [nodeId, inserted] = intern(st);
+        Node &next = nodes[nodeId];
+        if (inserted)
+          next.h = static_distance<E>(st, to);
+        else if (score >= next.g)
+          continue;
+        // the heuristic isn't consistent with additive effects, so closed nodes are reopened on a better path
+        next.g = score;
+        next.action = act;
+        next.parent = cur;
+        next.closed = false;
+        push(score + next.h, nodeId);
+      }
+    }
+    return 0.f;
+  }
+
+  // runtime counterparts, mostly to reuse print_plan and to compare against the runtime planner
+  template<typename E>
+  WorldState to_worldstate(const StaticState<E> &st)
+  {
+    WorldState res;
+    for (int8_t v : st)
+      res.push_back(v);
+    return res;
+  }
+
+  template<typename E, size_t A>
+  Planner to_planner(const StaticDomain<E, A> &domain, const std::array<const char *, static_width<E>> &state_names)
+  {
+    Planner res = create_planner();
+    add_states_to_planner(res, std::vector<std::string>(state_names.begin(), state_names.end()));
+    for (const StaticAction<E> &action : domain)
+    {
+      Precond precond;
+      Effect effect;
+      Effect additive;
+      for (size_t i = 0; i < static_width<E>; ++i)
+      {
+        if (action.precondition[i] >= 0)
+          precond.emplace_back(state_names[i], action.precondition[i]);
+        if (action.effect[i] >= 0)
+          effect.emplace_back(state_names[i], action.effect[i]);
+        if (action.additive[i] != 0)
+          additive.emplace_back(state_names[i], action.additive[i]);
+      }
+      add_action_to_planner(res, action.name, action.cost, precond, effect, additive);
+    }
+    return res;
+  }
+};
+
@@ -0,0 +1,78 @@
+#include "goapWorldState.h"
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GOAP_WORLDSTATE_SSE 1
+#else
+#define GOAP_WORLDSTATE_SSE 0
+#endif
+
+static_assert(goap::max_world_state_size % 16 == 0);
+
+#if GOAP_WORLDSTATE_SSE
+
+static __m128i load_slots(const goap::WorldState &st, size_t offset)
+{
+  return _mm_load_si128(reinterpret_cast<const __m128i *>(st.values + offset));
+}
+
+bool goap::operator==(const WorldState &lhs, const WorldState &rhs)
+{
+  if (lhs.count != rhs.count)
+    return false;
+  int eq = 0xffff;
+  for (size_t i = 0; i < max_world_state_size; i += 16)
+    eq &= _mm_movemask_epi8(_mm_cmpeq_epi8(load_slots(lhs, i), load_slots(rhs, i)));
+  return eq == 0xffff;
+}
+
+float goap::worldstate_distance(const WorldState &from, const WorldState &to)
+{
+  // biasing by 0x80 turns signed order into unsigned one, so max_epu8 - min_epu8 is the absolute difference
+  const __m128i bias = _mm_set1_epi8(-128);
+  const __m128i minusOne = _mm_set1_epi8(-1);
+  __m128i sum = _mm_setzero_si128();
+  for (size_t i = 0; i < max_world_state_size; i += 16)
+  {
+    const __m128i a = _mm_xor_si128(load_slots(from, i), bias);
+    const __m128i b = _mm_xor_si128(load_slots(to, i), bias);
+    const __m128i diff = _mm_sub_epi8(_mm_max_epu8(a, b), _mm_min_epu8(a, b));
+    const __m128i cares = _mm_cmpgt_epi8(load_slots(to, i), minusOne);
+    sum = _mm_add_epi64(sum, _mm_sad_epu8(_mm_and_si128(diff, cares), _mm_setzero_si128()));
+  }
+  sum = _mm_add_epi64(sum, _mm_srli_si128(sum, 8));
+  return float(_mm_cvtsi128_si32(sum));
+}
+
+#else
+
+bool goap::operator==(const WorldState &lhs, const WorldState &rhs)
+{
+  return lhs.count == rhs.count && memcmp(lhs.values, rhs.values, max_world_state_size) == 0;
+}
+
+float goap::worldstate_distance(const WorldState &from, const WorldState &to)
+{
+  int cost = 0;
+  for (size_t i = 0; i < max_world_state_size; ++i)
+    if (to[i] >= 0) // we care about it
+      cost += abs(to[i] - from[i]);
+  return float(cost);
+}
+
+#endif
+
+size_t goap::hash_worldstate(const WorldState &st)
+{
+  uint64_t words[max_world_state_size / sizeof(uint64_t)];
+  memcpy(words, st.values, sizeof(words));
+  uint64_t hash = st.count;
+  for (uint64_t w : words)
+  {
+    hash = (hash ^ w) * 0x9e3779b97f4a7c15ull;
+    hash ^= hash >> 29;
+  }
+  return hash;
+}
@@ -1,11 +1,53 @@
 #pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <unordered_map>
 #include <string>
 
 namespace goap
 {
-  using WorldState = std::vector<int8_t>;
+  constexpr size_t max_world_state_size = 32;
+
+  // fixed capacity so that states are copied without allocations and compared in whole registers,
+  // slots past size() are always kept at -1
+  struct alignas(16) WorldState
+  {
+    int8_t values[max_world_state_size];
+    uint8_t count = 0;
+
+    WorldState() { for (int8_t &v : values) v = -1; }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    void push_back(int8_t val)
+    {
+      assert(count < max_world_state_size);
+      if (count < max_world_state_size)
+        values[count++] = val;
+    }
+    void emplace_back(int8_t val) { push_back(val); }
+
+    int8_t &operator[](size_t i) { return values[i]; }
+    int8_t operator[](size_t i) const { return values[i]; }
+
+    int8_t *begin() { return values; }
+    int8_t *end() { return values + count; }
+    const int8_t *begin() const { return values; }
+    const int8_t *end() const { return values + count; }
+  };
+
+  bool operator==(const WorldState &lhs, const WorldState &rhs);
+  size_t hash_worldstate(const WorldState &st);
+  // sum of |to[i] - from[i]| over the slots the goal cares about (to[i] >= 0)
+  float worldstate_distance(const WorldState &from, const WorldState &to);
+
+  struct WorldStateHash
+  {
+    size_t operator()(const WorldState &st) const { return hash_worldstate(st); }
+  };
+
   using WorldDesc = std::unordered_map<std::string, size_t>;
 };
 
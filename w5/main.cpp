@@ -2,10 +2,20 @@
 #include "raylib.h"
 #include <flecs.h>
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include "ecsTypes.h"
 #include "roguelike.h"
 #include "dungeonGen.h"
+#include "dungeonUtils.h"
+#include "dijkstraMapGen.h"
+#include "dmapHierarchy.h"
 #include "goapPlanner.h"
+#include "goapHtn.h"
+#include "goapPlanBatch.h"
+#include "goapPlanCache.h"
+#include "goapPlanExecution.h"
+#include "goapStatic.h"
 
 enum EnemyDist
 {
@@ -21,57 +31,66 @@ enum HealthState
   Healthy
 };
 
-static void debug_enemy_planner()
+enum class EnemyWs
 {
-  goap::Planner pl = goap::create_planner();
-
-  goap::add_states_to_planner(pl,
-      {"enemy_vis",
-       "enemy_alive",
-       "have_melee",
-       "have_ranged",
-       "enemy_dist",
-       "health_state"});
-
-  goap::add_action_to_planner(pl, "wander", 1,
-      {{"health_state", Healthy}},
-      {{"enemy_vis", 1}},
-      {});
+  EnemyVis,
+  EnemyAlive,
+  HaveMelee,
+  HaveRanged,
+  EnemyDist,
+  HealthState,
+  Count
+};
 
-  goap::add_action_to_planner(pl, "approach_enemy", 1,
-      {{"health_state", Healthy}, {"enemy_vis", 1}},
+constexpr std::array<const char *, goap::static_width<EnemyWs>> enemy_state_names = {
+  "enemy_vis", "enemy_alive", "have_melee", "have_ranged", "enemy_dist", "health_state"};
+
+// enemy domain, built at compile time, runtime planner is made from it, so both stay the same
+constexpr auto enemy_static_domain = std::to_array<goap::StaticAction<EnemyWs>>({
+  goap::static_action<EnemyWs>("wander", 1,
+      {{EnemyWs::HealthState, Healthy}},
+      {{EnemyWs::EnemyVis, 1}},
+      {}),
+  goap::static_action<EnemyWs>("approach_enemy", 1,
+      {{EnemyWs::HealthState, Healthy}, {EnemyWs::EnemyVis, 1}},
       {},
-      {{"enemy_dist", -1}});
-
-  goap::add_action_to_planner(pl, "flee_enemy", 1,
-      {{"health_state", Healthy}, {"enemy_vis", 1}},
+      {{EnemyWs::EnemyDist, -1}}),
+  goap::static_action<EnemyWs>("flee_enemy", 1,
+      {{EnemyWs::HealthState, Healthy}, {EnemyWs::EnemyVis, 1}},
       {},
-      {{"enemy_dist", +1}});
-
-  goap::add_action_to_planner(pl, "find_melee", 1,
-      {{"have_melee", 0}, {"health_state", Healthy}},
-      {{"have_melee", 1}, {"enemy_dist", DistFar}},
-      {});
-
-  goap::add_action_to_planner(pl, "find_ranged", 1,
-      {{"have_ranged", 0}, {"health_state", Healthy}},
-      {{"have_ranged", 1}, {"enemy_dist", DistFar}},
-      {});
-
-  goap::add_action_to_planner(pl, "patch_up", 1,
-      {{"health_state", Injured}},
+      {{EnemyWs::EnemyDist, +1}}),
+  goap::static_action<EnemyWs>("find_melee", 1,
+      {{EnemyWs::HaveMelee, 0}, {EnemyWs::HealthState, Healthy}},
+      {{EnemyWs::HaveMelee, 1}, {EnemyWs::EnemyDist, DistFar}},
+      {}),
+  goap::static_action<EnemyWs>("find_ranged", 1,
+      {{EnemyWs::HaveRanged, 0}, {EnemyWs::HealthState, Healthy}},
+      {{EnemyWs::HaveRanged, 1}, {EnemyWs::EnemyDist, DistFar}},
+      {}),
+  goap::static_action<EnemyWs>("patch_up", 1,
+      {{EnemyWs::HealthState, Injured}},
       {},
-      {{"health_state", +1}});
-
-  goap::add_action_to_planner(pl, "attack_enemy", 1,
-      {{"enemy_vis", 1}, {"enemy_alive", 1}, {"have_melee", 1}, {"enemy_dist", DistMelee}, {"health_state", Healthy}},
-      {{"enemy_alive", 0}},
-      {{"health_state", -1}});
+      {{EnemyWs::HealthState, +1}}),
+  goap::static_action<EnemyWs>("attack_enemy", 1,
+      {{EnemyWs::EnemyVis, 1}, {EnemyWs::EnemyAlive, 1}, {EnemyWs::HaveMelee, 1}, {EnemyWs::EnemyDist, DistMelee},
+       {EnemyWs::HealthState, Healthy}},
+      {{EnemyWs::EnemyAlive, 0}},
+      {{EnemyWs::HealthState, -1}}),
+  goap::static_action<EnemyWs>("shoot_enemy", 1,
+      {{EnemyWs::EnemyVis, 1}, {EnemyWs::EnemyAlive, 1}, {EnemyWs::HaveRanged, 1}, {EnemyWs::EnemyDist, DistRanged},
+       {EnemyWs::HealthState, Healthy}},
+      {{EnemyWs::EnemyAlive, 0}},
+      {})
+});
+
+static goap::Planner make_enemy_planner()
+{
+  return goap::to_planner(enemy_static_domain, enemy_state_names);
+}
 
-  goap::add_action_to_planner(pl, "shoot_enemy", 1,
-      {{"enemy_vis", 1}, {"enemy_alive", 1}, {"have_ranged", 1}, {"enemy_dist", DistRanged}, {"health_state", Healthy}},
-      {{"enemy_alive", 0}},
-      {});
+static void debug_enemy_planner()
+{
+  goap::Planner pl = make_enemy_planner();
 
   {
     goap::WorldState ws = goap::produce_planner_worldstate(pl,
@@ -107,7 +126,7 @@ static void debug_enemy_planner()
   }
 }
 
-static void debug_looter_planner()
+static goap::Planner make_looter_planner()
 {
   goap::Planner pl = goap::create_planner();
 
@@ -171,7 +190,12 @@ static void debug_looter_planner()
       {{"escaped", 1}},
       {});
 
-  goap::WorldState ws = goap::produce_planner_worldstate(pl,
+  return pl;
+}
+
+static goap::WorldState make_looter_start(const goap::Planner &pl)
+{
+  return goap::produce_planner_worldstate(pl,
       {{"enemy_vis", 0},
        {"loot_vis", 1},
        {"num_loot", 0},
@@ -180,15 +204,417 @@ static void debug_looter_planner()
        {"enemy_dist", DistFar},
        {"health_state", Healthy},
        {"escaped", 0}});
+}
 
-  goap::WorldState goal = goap::produce_planner_worldstate(pl,
+static goap::WorldState make_looter_goal(const goap::Planner &pl)
+{
+  return goap::produce_planner_worldstate(pl,
       {{"num_loot", 5}, {"escaped", 1}, {"health_state", Healthy}});
+}
+
+static void debug_looter_planner()
+{
+  goap::Planner pl = make_looter_planner();
+
+  goap::WorldState ws = make_looter_start(pl);
+  goap::WorldState goal = make_looter_goal(pl);
 
   std::vector<goap::PlanStep> plan;
   goap::make_plan(pl, ws, goal, plan);
   goap::print_plan(pl, ws, plan);
 }
 
+#ifdef W5_DEBUG_HARNESSES // timing and sanity runs of the planners and dmaps, all run at startup when defined
+
+static void debug_plan_search()
+{
+  struct Scenario
+  {
+    const char *name;
+    goap::Planner planner;
+    goap::WorldState from;
+    goap::WorldState to;
+  };
+  std::vector<Scenario> scenarios;
+  {
+    goap::Planner pl = make_enemy_planner();
+    goap::WorldState ws = goap::produce_planner_worldstate(pl,
+        {{"enemy_vis", 0}, {"enemy_alive", 1}, {"have_melee", 0}, {"have_ranged", 0}, {"enemy_dist", DistFar},
+         {"health_state", Healthy}});
+    goap::WorldState goal = goap::produce_planner_worldstate(pl, {{"enemy_alive", 0}, {"health_state", Healthy}});
+    scenarios.push_back({"enemy", pl, ws, goal});
+  }
+  {
+    goap::Planner pl = make_looter_planner();
+    goap::WorldState ws = make_looter_start(pl);
+    goap::WorldState goal = make_looter_goal(pl);
+    scenarios.push_back({"looter", pl, ws, goal});
+  }
+  {
+    // goal is only reachable by overshooting it, relaxed heuristics must not treat 2 and 4 as dead ends
+    goap::Planner pl = goap::create_planner();
+    goap::add_states_to_planner(pl, {"x"});
+    goap::add_action_to_planner(pl, "up2", 1, {}, {}, {{"x", +2}});
+    goap::add_action_to_planner(pl, "down3", 1, {}, {}, {{"x", -3}});
+    scenarios.push_back({"overshoot", pl, goap::produce_planner_worldstate(pl, {{"x", 0}}),
+                         goap::produce_planner_worldstate(pl, {{"x", 1}})});
+  }
+  constexpr int iterations = 1000;
+  const char *heuristicNames[] = {"distance", "h_max", "h_add"};
+  for (Scenario &sc : scenarios)
+    for (goap::PlanSearch search : {goap::PlanSearch::Forward, goap::PlanSearch::Regressive})
+      for (goap::PlanHeuristic heuristic : {goap::PlanHeuristic::Distance, goap::PlanHeuristic::HMax, goap::PlanHeuristic::HAdd})
+      {
+        goap::set_planner_search(sc.planner, search);
+        goap::set_planner_heuristic(sc.planner, heuristic);
+        goap::PlanStats stats;
+        std::vector<goap::PlanStep> plan;
+        float cost = 0.f;
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+          goap::clear_plan_cache();
+          stats = {};
+          plan.clear();
+          cost = goap::make_plan(sc.planner, sc.from, sc.to, plan, &stats);
+        }
+        const std::chrono::duration<double, std::micro> time = std::chrono::steady_clock::now() - start;
+        printf("%s %s %s: cost %.1f, %zu steps, %zu expanded, %zu generated, %.2f us\n", sc.name,
+               search == goap::PlanSearch::Forward ? "forward" : "regressive", heuristicNames[size_t(heuristic)],
+               double(cost), plan.size(), stats.nodesExpanded, stats.nodesGenerated, time.count() / iterations);
+      }
+}
+
+static void debug_plan_session()
+{
+  goap::Planner pl = make_looter_planner();
+  goap::WorldState ws = make_looter_start(pl);
+  goap::WorldState goal = make_looter_goal(pl);
+
+  goap::clear_plan_cache();
+  goap::PlanSession session = goap::start_plan_session(pl, ws, goal);
+  int turn = 0;
+  while (goap::continue_plan_session(session, {20, 0.f}) == goap::PlanStatus::Searching)
+  {
+    std::vector<goap::PlanStep> partial;
+    const float cost = goap::get_session_plan(session, partial);
+    printf("turn %d: %zu nodes expanded, best partial plan %zu steps, cost %.1f\n", turn++,
+           session.stats.nodesExpanded, partial.size(), double(cost));
+  }
+  std::vector<goap::PlanStep> plan;
+  goap::get_session_plan(session, plan);
+  goap::print_plan(pl, ws, plan);
+}
+
+static void debug_batch_planning()
+{
+  goap::Planner pl = make_looter_planner();
+  std::vector<goap::PlanRequest> requests;
+  for (int loot = 1; loot <= 20; ++loot)
+    for (int dist = DistMelee; dist <= DistFar; ++dist)
+      for (int health = Injured; health <= Healthy; ++health)
+      {
+        goap::WorldState ws = goap::produce_planner_worldstate(pl,
+            {{"enemy_vis", 0}, {"loot_vis", 1}, {"num_loot", 0}, {"have_melee", 1}, {"have_ranged", 1},
+             {"enemy_dist", dist}, {"health_state", health}, {"escaped", 0}});
+        goap::WorldState goal = goap::produce_planner_worldstate(pl, {{"num_loot", loot}, {"health_state", Healthy}});
+        requests.push_back({requests.size(), ws, goal});
+      }
+
+  std::vector<goap::PlanResult> serial(requests.size());
+  std::vector<goap::PlanResult> parallel(requests.size());
+  goap::PlanWorkers workers; // kept between batches like it would be between turns
+  auto timeBatch = [&](std::vector<goap::PlanResult> &results, size_t num_workers)
+  {
+    goap::clear_plan_cache();
+    const auto start = std::chrono::steady_clock::now();
+    goap::make_plans(pl, workers, requests, results, num_workers);
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  };
+  const double serialTime = timeBatch(serial, 1);
+  const double parallelTime = timeBatch(parallel, 0);
+  size_t mismatches = 0;
+  for (size_t i = 0; i < requests.size(); ++i)
+    if (serial[i].agent != parallel[i].agent || serial[i].cost != parallel[i].cost ||
+        serial[i].plan.size() != parallel[i].plan.size())
+      mismatches++;
+  printf("%zu plans: serial %.2f ms, parallel %.2f ms, %zu mismatches\n", requests.size(), serialTime, parallelTime,
+         mismatches);
+}
+
+static void debug_plan_execution()
+{
+  goap::Planner pl = make_looter_planner();
+  goap::WorldState ws = make_looter_start(pl);
+  goap::WorldState goal = make_looter_goal(pl);
+
+  goap::PlanExecution exec;
+  goap::start_plan_execution(exec, pl, ws, goal);
+  const size_t enemyDist = pl.wdesc.at("enemy_dist");
+  const size_t healthState = pl.wdesc.at("health_state");
+  for (int turn = 0; turn < 100; ++turn)
+  {
+    // the world doesn't always go as predicted
+    if (turn == 3)
+      ws[enemyDist] = DistFar;
+    if (turn == 10)
+      ws[healthState] = Injured;
+    const size_t act = goap::update_plan_execution(exec, pl, ws);
+    if (act == size_t(-1))
+      break;
+    printf("%d: %s\n", turn, pl.actions[act].name.c_str());
+    ws = goap::apply_action(pl, act, ws);
+  }
+  printf("goal reached: %s, repairs: %zu, replans: %zu\n", goap::worldstate_distance(ws, goal) == 0 ? "yes" : "no",
+         exec.repairs, exec.replans);
+}
+
+static void debug_looter_htn()
+{
+  goap::Planner pl = make_looter_planner();
+  goap::HtnDomain htn = goap::create_htn_domain(pl);
+
+  goap::add_htn_method(htn, pl, "loot_and_escape", "loot_and_escape", {}, {"collect_loot", "escape"});
+
+  goap::add_htn_method(htn, pl, "collect_loot", "enough", {{"num_loot", 5}}, {});
+  goap::add_htn_method(htn, pl, "collect_loot", "heal", {{"health_state", Injured}}, {"patch_up", "collect_loot"});
+  goap::add_htn_method(htn, pl, "collect_loot", "fight", {{"enemy_vis", 1}}, {"kill_enemy", "collect_loot"});
+  goap::add_htn_method(htn, pl, "collect_loot", "grab", {{"loot_vis", 1}}, {"loot", "collect_loot"});
+  goap::add_htn_method(htn, pl, "collect_loot", "explore", {}, {"open_room", "collect_loot"});
+
+  goap::add_htn_method(htn, pl, "kill_enemy", "stab", {{"have_melee", 1}, {"enemy_dist", DistMelee}}, {"attack_enemy"});
+  goap::add_htn_method(htn, pl, "kill_enemy", "close_in", {{"have_melee", 1}}, {"approach_enemy", "kill_enemy"});
+  goap::add_htn_method(htn, pl, "kill_enemy", "shoot", {{"have_ranged", 1}, {"enemy_dist", DistRanged}}, {"shoot_enemy"});
+
+  goap::WorldState ws = make_looter_start(pl);
+
+  constexpr int iterations = 1000;
+  std::vector<goap::PlanStep> plan;
+  float cost = 0.f;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i)
+  {
+    plan.clear();
+    cost = goap::make_htn_plan(htn, pl, "loot_and_escape", ws, plan);
+  }
+  const std::chrono::duration<double, std::micro> time = std::chrono::steady_clock::now() - start;
+  goap::print_plan(pl, ws, plan);
+  printf("htn: cost %.1f, %zu steps, %.2f us\n", double(cost), plan.size(), time.count() / iterations);
+}
+
+static void debug_static_planner()
+{
+  constexpr goap::StaticState<EnemyWs> ws = goap::static_state<EnemyWs>(
+      {{EnemyWs::EnemyVis, 0}, {EnemyWs::EnemyAlive, 1}, {EnemyWs::HaveMelee, 0}, {EnemyWs::HaveRanged, 0},
+       {EnemyWs::EnemyDist, DistFar}, {EnemyWs::HealthState, Healthy}});
+  constexpr goap::StaticState<EnemyWs> goal = goap::static_state<EnemyWs>(
+      {{EnemyWs::EnemyAlive, 0}, {EnemyWs::HealthState, Healthy}});
+  static_assert(goap::static_action_valid(enemy_static_domain[0], ws), "enemy should be able to wander");
+
+  constexpr int iterations = 1000;
+  std::vector<goap::StaticPlanStep<EnemyWs>> plan;
+  float cost = 0.f;
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i)
+  {
+    plan.clear();
+    cost = goap::make_static_plan(enemy_static_domain, ws, goal, plan);
+  }
+  const std::chrono::duration<double, std::micro> time = std::chrono::steady_clock::now() - start;
+
+  goap::Planner pl = make_enemy_planner();
+  std::vector<goap::PlanStep> steps;
+  for (const goap::StaticPlanStep<EnemyWs> &step : plan)
+    steps.push_back({step.action, goap::to_worldstate<EnemyWs>(step.worldState)});
+  goap::print_plan(pl, goap::to_worldstate<EnemyWs>(ws), steps);
+  printf("static: cost %.1f, %.2f us\n", double(cost), time.count() / iterations);
+}
+
+static void debug_dmap_generators(flecs::world &ecs)
+{
+  using GenFunc = void (*)(flecs::world &, std::vector<float> &, dmaps::Backend);
+  const std::pair<const char *, GenFunc> generators[] = {
+    {"approach_map", dmaps::gen_player_approach_map},
+    {"flee_map", dmaps::gen_player_flee_map},
+    {"hive_map", dmaps::gen_hive_pack_map}};
+  for (const auto &gen : generators)
+  {
+    std::vector<float> scanMap;
+    std::vector<float> queueMap;
+    gen.second(ecs, scanMap, dmaps::Backend::Scan);
+    gen.second(ecs, queueMap, dmaps::Backend::Queue);
+    size_t mismatches = scanMap.size() == queueMap.size() ? 0 : scanMap.size();
+    for (size_t i = 0; i < std::min(scanMap.size(), queueMap.size()); ++i)
+      if (scanMap[i] != queueMap[i])
+        mismatches++;
+    printf("%s: %zu mismatches between scan and queue versions\n", gen.first, mismatches);
+  }
+}
+
+static void debug_dmap_backends(flecs::world &ecs)
+{
+  const std::pair<const char *, dmaps::Backend> backends[] = {
+    {"scan", dmaps::Backend::Scan},
+    {"queue", dmaps::Backend::Queue},
+    {"sweep", dmaps::Backend::Sweep}};
+  auto bench = [&](const char *name, const DungeonData &dd, const std::vector<dmaps::Seed> &seeds)
+  {
+    constexpr int iterations = 20;
+    std::vector<float> reference;
+    dmaps::gen_map(reference, dd, seeds, dmaps::Backend::Queue);
+    for (const auto &backend : backends)
+    {
+      std::vector<float> map;
+      const auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < iterations; ++i)
+        dmaps::gen_map(map, dd, seeds, backend.second);
+      const auto time = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start);
+      printf("%s, %s: %.1f us per map, %s\n", name, backend.first, time.count() / iterations,
+             map == reference ? "same as queue" : "DIFFERENT from queue");
+    }
+  };
+
+  static auto dungeonDataQuery = ecs.query<const DungeonData>();
+  dungeonDataQuery.each([&](const DungeonData &dd)
+  {
+    bench("dungeon", dd, dmaps::gather_player_seeds(ecs, dd));
+  });
+
+  // sweeping is at its best on open areas, so check it on a single big room as well
+  DungeonData room;
+  room.width = 256;
+  room.height = 256;
+  room.tiles.assign(room.width * room.height, dungeon::floor);
+  for (size_t i = 0; i < room.width; ++i)
+  {
+    room.tiles[i] = room.tiles[(room.height - 1) * room.width + i] = dungeon::wall;
+    room.tiles[i * room.width] = room.tiles[i * room.width + room.width - 1] = dungeon::wall;
+  }
+  bench("open room", room, {{room.width * room.height / 2 + room.width / 2, 0.f}});
+
+  // and on a cave of the same size, where winding paths take it many more passes
+  DungeonData cave;
+  cave.width = 256;
+  cave.height = 256;
+  cave.tiles.resize(cave.width * cave.height);
+  gen_drunk_dungeon(cave.tiles.data(), cave.width, cave.height);
+  const size_t caveSeed = size_t(std::find(cave.tiles.begin(), cave.tiles.end(), dungeon::floor) - cave.tiles.begin());
+  bench("cave", cave, {{caveSeed, 0.f}});
+}
+
+static void debug_bounded_dmaps(flecs::world &ecs)
+{
+  static auto dungeonDataQuery = ecs.query<const DungeonData>();
+  dungeonDataQuery.each([&](const DungeonData &dd)
+  {
+    const std::vector<dmaps::Seed> seeds = dmaps::gather_player_seeds(ecs, dd);
+    std::vector<float> full;
+    dmaps::gen_map(full, dd, seeds);
+    for (float radius : {4.f, 8.f, 16.f})
+    {
+      DijkstraMapData bounded;
+      const auto start = std::chrono::steady_clock::now();
+      dmaps::gen_bounded_map(bounded, dd, seeds, radius);
+      const auto time = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start);
+      // player seeds are all zero, so inside the radius values are the same as in the full map
+      size_t mismatches = 0;
+      for (size_t i = 0; i < full.size(); ++i)
+        if (bounded.at(i) != (full[i] <= radius ? full[i] : 1e5f))
+          mismatches++;
+      printf("radius %.0f: %.1f us, %zu of %zu chunks allocated, %zu mismatches with full map\n", double(radius),
+             time.count(), bounded.chunkValues.size() / (DijkstraMapData::chunk_size * DijkstraMapData::chunk_size),
+             bounded.chunks.size(), mismatches);
+    }
+  });
+}
+
+static void debug_hierarchical_dmaps(flecs::world &ecs)
+{
+  static auto dungeonDataQuery = ecs.query<const DungeonData>();
+  static auto monstersQuery = ecs.query<const Position, const Team>();
+  dungeonDataQuery.each([&](const DungeonData &dd)
+  {
+    const std::vector<dmaps::Seed> seeds = dmaps::gather_player_seeds(ecs, dd);
+    std::vector<size_t> consumers;
+    monstersQuery.each([&](const Position &pos, const Team &t)
+    {
+      if (t.team != 0)
+        consumers.push_back(size_t(pos.y) * dd.width + size_t(pos.x));
+    });
+    std::vector<float> full;
+    dmaps::gen_map(full, dd, seeds);
+    dmaps::CoarseGraph graph;
+    dmaps::build_coarse_graph(graph, dd);
+    for (size_t radius : {size_t(4), size_t(8), size_t(16)})
+    {
+      DijkstraMapData map;
+      const auto start = std::chrono::steady_clock::now();
+      dmaps::gen_hierarchical_map(map, graph, dd, seeds, consumers, radius);
+      const auto time = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start);
+      // consumers only care which neighbour is the lowest one
+      size_t sameMoves = 0;
+      for (size_t c : consumers)
+      {
+        const size_t tiles[] = {c, c - 1, c + 1, c - dd.width, c + dd.width};
+        size_t fullBest = 0;
+        size_t mapBest = 0;
+        for (size_t i = 1; i < 5; ++i)
+        {
+          if (dd.tiles[tiles[i]] != dungeon::floor)
+            continue;
+          if (full[tiles[i]] < full[tiles[fullBest]])
+            fullBest = i;
+          if (map.at(tiles[i]) < map.at(tiles[mapBest]))
+            mapBest = i;
+        }
+        if (full[tiles[mapBest]] == full[tiles[fullBest]])
+          sameMoves++;
+      }
+      printf("fine radius %zu: %.1f us, %zu of %zu consumers move as with full map\n", radius, time.count(),
+             sameMoves, consumers.size());
+    }
+  });
+}
+
+// walks a sparse map through demanded, skipped and demanded again with the same inputs, like update_dmaps does
+static void debug_dmap_republish(flecs::world &ecs)
+{
+  static auto dungeonDataQuery = ecs.query<const DungeonData>();
+  dungeonDataQuery.each([&](const DungeonData &dd)
+  {
+    const std::vector<dmaps::Seed> seeds = dmaps::gather_player_seeds(ecs, dd);
+    std::vector<dmaps::Seed> movedSeeds;
+    for (const dmaps::Seed &seed : seeds)
+      for (size_t tile : {seed.tile - 1, seed.tile + 1, seed.tile - dd.width, seed.tile + dd.width})
+        if (dd.tiles[tile] == dungeon::floor)
+        {
+          movedSeeds.push_back({tile, seed.value});
+          break;
+        }
+    DijkstraMapData expected;
+    dmaps::gen_bounded_map(expected, dd, movedSeeds, 8.f);
+
+    dmaps::MapBuffer buf;
+    buf.maxRadius = 8.f;
+    DijkstraMapData published;
+    dmaps::upd_map(buf, dd, seeds);
+    dmaps::publish_map(published, buf);
+    dmaps::upd_map(buf, dd, movedSeeds);
+    dmaps::publish_map(published, buf);
+    buf.stale = true; // nobody needed it for a turn
+    dmaps::upd_map(buf, dd, movedSeeds);
+    const bool skipped = buf.upToDate;
+    dmaps::publish_map(published, buf);
+    size_t mismatches = published.size() == expected.size() ? 0 : expected.size();
+    for (size_t i = 0; i < std::min(published.size(), expected.size()); ++i)
+      if (published.at(i) != expected.at(i))
+        mismatches++;
+    printf("republished %s map: %zu mismatches with freshly generated one\n", skipped ? "skipped" : "regenerated",
+           mismatches);
+  });
+}
+
+#endif
 
 static void update_camera(Camera2D &cam, flecs::world &ecs)
 {
@@ -227,6 +653,19 @@ int main(int /*argc*/, const char ** /*argv*/)
   init_roguelike(ecs);
   //debug_enemy_planner();
   debug_looter_planner();
+#ifdef W5_DEBUG_HARNESSES
+  debug_dmap_generators(ecs);
+  debug_dmap_backends(ecs);
+  debug_bounded_dmaps(ecs);
+  debug_hierarchical_dmaps(ecs);
+  debug_dmap_republish(ecs);
+  debug_plan_search();
+  debug_plan_session();
+  debug_batch_planning();
+  debug_plan_execution();
+  debug_looter_htn();
+  debug_static_planner();
+#endif
 
   Camera2D camera = { {0, 0}, {0, 0}, 0.f, 1.f };
   camera.target = Vector2{ 0.f, 0.f };
@@ -7,6 +7,9 @@
 #include "math.h"
 #include "dungeonUtils.h"
 #include "dijkstraMapGen.h"
+#include "dmapHierarchy.h"
+#include "dmapJobs.h"
+#include "dmapRegistry.h"
 #include "dmapFollower.h"
 #include "dmapBeh.h"
 #include "rlikeObjects.h"
@@ -80,27 +83,20 @@ static void register_roguelike_systems(flecs::world &ecs)
     {
       SetTextureFilter(tex, TEXTURE_FILTER_POINT);
     });
-  ecs.system<const DmapWeights>()
+  ecs.system<const DmapWeightIds>()
     .term<VisualiseMap>()
-    .each([&](const DmapWeights &wt)
+    .each([&](const DmapWeightIds &wt)
     {
+      const std::vector<const DijkstraMapData *> maps = dmaps::resolve_maps(ecs);
+      dmaps::Registry *registry = ecs.get_mut<dmaps::Registry>();
       dungeonDataQuery.each([&](const DungeonData &dd)
       {
+        // same composite as followers use, it's only recomputed after the maps change
+        dmaps::CompositeMap &composite = dmaps::get_composite(*registry, wt.compositeId, dd.width * dd.height);
         for (size_t y = 0; y < dd.height; ++y)
           for (size_t x = 0; x < dd.width; ++x)
           {
-            float sum = 0.f;
-            for (const auto &pair : wt.weights)
-            {
-              ecs.entity(pair.first.c_str()).get([&](const DijkstraMapData &dmap)
-              {
-                float v = dmap.map[y * dd.width + x];
-                if (v < 1e5f)
-                  sum += powf(v * pair.second.mult, pair.second.pow);
-                else
-                  sum += v;
-              });
-            }
+            const float sum = dmaps::composite_at(composite, maps, y * dd.width + x);
             if (sum < 1e5f)
               DrawText(TextFormat("%.1f", sum),
                   int((float(x) + 0.2f) * tile_size), int((float(y) + 0.5f) * tile_size), 150, WHITE);
@@ -116,7 +112,7 @@ static void register_roguelike_systems(flecs::world &ecs)
         for (size_t y = 0; y < dd.height; ++y)
           for (size_t x = 0; x < dd.width; ++x)
           {
-            const float val = dmap.map[y * dd.width + x];
+            const float val = dmap.at(y * dd.width + x);
             if (val < 1e5f)
               DrawText(TextFormat("%.1f", val),
                   int((float(x) + 0.2f) * tile_size), int((float(y) + 0.5f) * tile_size), 150, WHITE);
@@ -129,6 +125,7 @@ static void register_roguelike_systems(flecs::world &ecs)
 void init_roguelike(flecs::world &ecs)
 {
   register_roguelike_systems(ecs);
+  dmaps::init_registry(ecs);
 
   ecs.entity("swordsman_tex")
     .set(Texture2D{LoadTexture("assets/swordsman.png")});
@@ -152,6 +149,13 @@ void init_roguelike(flecs::world &ecs)
   ecs.entity("world")
     .set(TurnCounter{})
     .set(ActionLog{});
+
+  // halves memory traffic of followers, integer distances of approach and hive maps stay exact
+  for (const char *mapName : {"approach_map", "flee_map", "hive_map"})
+  {
+    const size_t mapId = dmaps::intern_map(ecs, mapName);
+    ecs.get<dmaps::Registry>()->maps[mapId].get_mut<DijkstraMapData>()->storage = DijkstraMapData::Storage::Fixed;
+  }
 }
 
 void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
@@ -167,7 +171,8 @@ void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
     for (size_t x = 0; x < w; ++x)
       dungeonData[y * w + x] = tiles[y * w + x];
   ecs.entity("dungeon")
-    .set(DungeonData{dungeonData, w, h});
+    .set(DungeonData{dungeonData, w, h, 0})
+    .set(dmaps::CoarseGraph{});
 
   for (size_t y = 0; y < h; ++y)
     for (size_t x = 0; x < w; ++x)
@@ -354,6 +359,87 @@ static void gather_world_info(flecs::world &ecs)
   });
 }
 
+// doesn't trigger OnSet and change detection when the value is the same
+template<typename T>
+static flecs::entity set_if_changed(flecs::entity e, const T &value)
+{
+  const T *cur = e.get<T>();
+  if (!cur || !(*cur == value))
+    e.set(value);
+  return e;
+}
+
+static void publish_dmap(dmaps::Registry &registry, size_t map_id, dmaps::MapBuffer &buf)
+{
+  const flecs::entity map_entity = registry.maps[map_id];
+  dmaps::publish_map(*map_entity.get_mut<DijkstraMapData>(), buf);
+  registry.versions[map_id]++;
+  map_entity.modified<DijkstraMapData>();
+}
+
+static void update_dmaps(flecs::world &ecs)
+{
+  static auto dungeonDataQuery = ecs.query<const DungeonData, dmaps::CoarseGraph>();
+  static const size_t approachId = dmaps::intern_map(ecs, "approach_map");
+  static const size_t fleeId = dmaps::intern_map(ecs, "flee_map");
+  static const size_t hiveId = dmaps::intern_map(ecs, "hive_map");
+  static const dmaps::FleeParams fleeParams{.coefficient = -1.2f, .maxRadius = std::numeric_limits<float>::infinity()};
+  std::vector<bool> demanded = dmaps::gather_demanded_maps(ecs);
+  if (demanded[fleeId]) // flee map is built from the approach one
+    demanded[approachId] = true;
+
+  dmaps::Registry *registry = ecs.get_mut<dmaps::Registry>();
+  dmaps::MapBuffer *approach = registry->maps[approachId].get_mut<dmaps::MapBuffer>();
+  dmaps::MapBuffer *flee = registry->maps[fleeId].get_mut<dmaps::MapBuffer>();
+  dmaps::MapBuffer *hive = registry->maps[hiveId].get_mut<dmaps::MapBuffer>();
+  // flee map follows approach map changes, after missing some of them it has to start over
+  if (demanded[fleeId] && flee->stale)
+    flee->map.clear();
+  dungeonDataQuery.each([&](const DungeonData &dd, dmaps::CoarseGraph &graph)
+  {
+    if (graph.dungeonVersion != dd.version)
+      dmaps::build_coarse_graph(graph, dd);
+    // hierarchical maps compute exact values only around their consumers
+    auto consumersOf = [&](size_t id, const dmaps::MapBuffer &buf)
+    {
+      return buf.fineRadius > 0 ? dmaps::gather_map_consumers(ecs, dd, id) : std::vector<size_t>{};
+    };
+    std::vector<dmaps::Seed> playerSeeds;
+    std::vector<dmaps::Seed> hiveSeeds;
+    std::vector<size_t> approachConsumers;
+    std::vector<size_t> hiveConsumers;
+    dmaps::JobGraph jobs;
+    if (demanded[approachId])
+    {
+      playerSeeds = dmaps::gather_player_seeds(ecs, dd);
+      approachConsumers = consumersOf(approachId, *approach);
+      const size_t approachJob = dmaps::add_job(jobs, [&]()
+      {
+        dmaps::upd_map(*approach, dd, playerSeeds, &graph, approachConsumers);
+      });
+      if (demanded[fleeId])
+        dmaps::add_job(jobs, [&]() { dmaps::upd_player_flee_map(*flee, dd, *approach, fleeParams); }, {approachJob});
+    }
+    if (demanded[hiveId])
+    {
+      hiveSeeds = dmaps::gather_hive_seeds(ecs, dd);
+      hiveConsumers = consumersOf(hiveId, *hive);
+      dmaps::add_job(jobs, [&]() { dmaps::upd_map(*hive, dd, hiveSeeds, &graph, hiveConsumers); });
+    }
+    dmaps::run_jobs(jobs);
+  });
+
+  // nobody sees a half-updated set of maps
+  for (size_t id : {approachId, fleeId, hiveId})
+  {
+    dmaps::MapBuffer *buf = registry->maps[id].get_mut<dmaps::MapBuffer>();
+    if (!demanded[id])
+      buf->stale = true;
+    else if (!buf->upToDate || buf->stale) // otherwise leave the component and composites built on it alone
+      publish_dmap(*registry, id, *buf);
+  }
+}
+
 void process_turn(flecs::world &ecs)
 {
   static auto stateMachineAct = ecs.query<StateMachine>();
@@ -381,24 +467,11 @@ void process_turn(flecs::world &ecs)
     }
     process_actions(ecs);
 
-    std::vector<float> approachMap;
-    dmaps::gen_player_approach_map(ecs, approachMap);
-    ecs.entity("approach_map")
-      .set(DijkstraMapData{approachMap});
-
-    std::vector<float> fleeMap;
-    dmaps::gen_player_flee_map(ecs, fleeMap);
-    ecs.entity("flee_map")
-      .set(DijkstraMapData{fleeMap});
-
-    std::vector<float> hiveMap;
-    dmaps::gen_hive_pack_map(ecs, hiveMap);
-    ecs.entity("hive_map")
-      .set(DijkstraMapData{hiveMap});
+    update_dmaps(ecs);
 
     //ecs.entity("flee_map").add<VisualiseMap>();
-    ecs.entity("hive_follower_sum")
-      .set(DmapWeights{{{"hive_map", {1.f, 1.f}}, {"approach_map", {1.8f, 0.8f}}}})
+    static const DmapWeights hiveFollowerSum{{{"hive_map", {1.f, 1.f}}, {"approach_map", {1.8f, 0.8f}}}};
+    set_if_changed(ecs.entity("hive_follower_sum"), hiveFollowerSum)
       .add<VisualiseMap>();
   }
 }
@@ -412,6 +485,16 @@ void print_stats(flecs::world &ecs)
     DrawText(TextFormat("power: %d", int(dmg.damage)), 20, 40, 20, WHITE);
   });
 
+  static auto dmapBuffersQuery = ecs.query<const dmaps::MapBuffer>();
+  size_t dmapUpdates = 0;
+  size_t dmapSkips = 0;
+  dmapBuffersQuery.each([&](const dmaps::MapBuffer &buf)
+  {
+    dmapUpdates += buf.updates;
+    dmapSkips += buf.skippedUpdates;
+  });
+  DrawText(TextFormat("dmap updates: %d, skipped: %d", int(dmapUpdates), int(dmapSkips)), 20, 60, 20, WHITE);
+
   static auto actionLogQuery = ecs.query<const ActionLog>();
   actionLogQuery.each([&](const ActionLog &l)
   {
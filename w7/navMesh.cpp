@@ -0,0 +1,261 @@
+#include "navMesh.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <limits>
+#include <queue>
+
+constexpr size_t invalid_rect = size_t(-1);
+
+static Position portal_center(const NavRectConnection &conn)
+{
+  return (conn.portalFrom + conn.portalTo) * 0.5f;
+}
+
+DungeonNavMesh build_nav_mesh(const DungeonData &dd)
+{
+  DungeonNavMesh nm;
+  nm.width = dd.width;
+  nm.height = dd.height;
+  nm.tileRects.assign(dd.width * dd.height, invalid_rect);
+
+  auto isFree = [&](size_t x, size_t y)
+  {
+    const size_t idx = y * dd.width + x;
+    return dd.tiles[idx] != dungeon::wall && nm.tileRects[idx] == invalid_rect;
+  };
+
+  // greedy decomposition: from each uncovered tile (in scan order) grow the largest area rectangle
+  for (size_t y = 0; y < dd.height; ++y)
+    for (size_t x = 0; x < dd.width; ++x)
+    {
+      if (!isFree(x, y))
+        continue;
+      size_t maxWidth = dd.width - x;
+      size_t bestArea = 0;
+      size_t bestWidth = 0;
+      size_t bestHeight = 0;
+      for (size_t yy = y; yy < dd.height && isFree(x, yy); ++yy)
+      {
+        size_t rowWidth = 0;
+        while (rowWidth < maxWidth && isFree(x + rowWidth, yy))
+          rowWidth++;
+        maxWidth = rowWidth;
+        const size_t area = maxWidth * (yy - y + 1);
+        if (area > bestArea)
+        {
+          bestArea = area;
+          bestWidth = maxWidth;
+          bestHeight = yy - y + 1;
+        }
+      }
+      const size_t rectIdx = nm.rects.size();
+      nm.rects.push_back({.start = {int(x), int(y)},
+                          .end = {int(x + bestWidth - 1), int(y + bestHeight - 1)},
+                          .conns = {}});
+      for (size_t yy = y; yy < y + bestHeight; ++yy)
+        for (size_t xx = x; xx < x + bestWidth; ++xx)
+          nm.tileRects[yy * dd.width + xx] = rectIdx;
+    }
+
+  // connect rects through their shared edges, it's enough to check right and bottom borders
+  auto connect = [&](size_t a, size_t b, Position from, Position to)
+  {
+    nm.rects[a].conns.push_back({b, from, to});
+    nm.rects[b].conns.push_back({a, from, to});
+  };
+  for (size_t a = 0; a < nm.rects.size(); ++a)
+  {
+    const IVec2 start = nm.rects[a].start;
+    const IVec2 end = nm.rects[a].end;
+    if (size_t(end.x + 1) < dd.width)
+    {
+      const size_t x = size_t(end.x + 1);
+      for (size_t y = size_t(start.y); y <= size_t(end.y);)
+      {
+        const size_t b = nm.tileRects[y * dd.width + x];
+        size_t spanEnd = y;
+        while (spanEnd + 1 <= size_t(end.y) && nm.tileRects[(spanEnd + 1) * dd.width + x] == b)
+          spanEnd++;
+        if (b != invalid_rect)
+          connect(a, b, Position{float(x), float(y)}, Position{float(x), float(spanEnd + 1)});
+        y = spanEnd + 1;
+      }
+    }
+    if (size_t(end.y + 1) < dd.height)
+    {
+      const size_t y = size_t(end.y + 1);
+      for (size_t x = size_t(start.x); x <= size_t(end.x);)
+      {
+        const size_t b = nm.tileRects[y * dd.width + x];
+        size_t spanEnd = x;
+        while (spanEnd + 1 <= size_t(end.x) && nm.tileRects[y * dd.width + spanEnd + 1] == b)
+          spanEnd++;
+        if (b != invalid_rect)
+          connect(a, b, Position{float(x), float(y)}, Position{float(spanEnd + 1), float(y)});
+        x = spanEnd + 1;
+      }
+    }
+  }
+  return nm;
+}
+
+void prebuild_nav_mesh(flecs::world &ecs)
+{
+  auto mapQuery = ecs.query<const DungeonData>();
+
+  ecs.defer([&]()
+  {
+    mapQuery.each([&](flecs::entity e, const DungeonData &dd)
+    {
+      e.set(build_nav_mesh(dd));
+    });
+  });
+}
+
+static size_t find_rect(const DungeonNavMesh &nm, Position pos)
+{
+  if (pos.x < 0.f || pos.y < 0.f || pos.x >= float(nm.width) || pos.y >= float(nm.height))
+    return invalid_rect;
+  return nm.tileRects[size_t(pos.y) * nm.width + size_t(pos.x)];
+}
+
+static std::vector<size_t> find_rect_path_a_star(const DungeonNavMesh &nm, size_t from_rect, size_t to_rect,
+                                                 Position from, Position to)
+{
+  const size_t inpSize = nm.rects.size();
+  // every rect is entered through a portal, use its center as a position of the node
+  std::vector<float> g(inpSize, std::numeric_limits<float>::max());
+  std::vector<Position> entry(inpSize, from);
+  std::vector<size_t> prev(inpSize, invalid_rect);
+  std::vector<bool> closed(inpSize, false);
+
+  using OpenEntry = std::pair<float, size_t>;
+  std::priority_queue<OpenEntry, std::vector<OpenEntry>, std::greater<OpenEntry>> openList;
+  g[from_rect] = 0.f;
+  openList.push({dist(from, to), from_rect});
+  while (!openList.empty())
+  {
+    const size_t curIdx = openList.top().second;
+    openList.pop();
+    if (curIdx == to_rect)
+    {
+      std::vector<size_t> res;
+      for (size_t idx = to_rect; idx != invalid_rect; idx = prev[idx])
+        res.push_back(idx);
+      std::reverse(res.begin(), res.end());
+      return res;
+    }
+    if (closed[curIdx])
+      continue;
+    closed[curIdx] = true;
+    for (const NavRectConnection &conn : nm.rects[curIdx].conns)
+    {
+      if (closed[conn.rectIdx])
+        continue;
+      const Position center = portal_center(conn);
+      const float gScore = g[curIdx] + dist(entry[curIdx], center);
+      if (gScore < g[conn.rectIdx])
+      {
+        g[conn.rectIdx] = gScore;
+        entry[conn.rectIdx] = center;
+        prev[conn.rectIdx] = curIdx;
+        openList.push({gScore + dist(center, to), conn.rectIdx});
+      }
+    }
+  }
+  return {};
+}
+
+static float triarea2(Position a, Position b, Position c)
+{
+  return (c.x - a.x) * (b.y - a.y) - (b.x - a.x) * (c.y - a.y);
+}
+
+// simple stupid funnel algorithm, portals are (left, right) pairs in the direction of travel
+static std::vector<Position> string_pull(const std::vector<std::pair<Position, Position>> &portals)
+{
+  std::vector<Position> res = {portals.front().first};
+  Position portalApex = portals.front().first;
+  Position portalLeft = portals.front().first;
+  Position portalRight = portals.front().second;
+  size_t apexIdx = 0;
+  size_t leftIdx = 0;
+  size_t rightIdx = 0;
+  for (size_t i = 1; i < portals.size(); ++i)
+  {
+    const Position left = portals[i].first;
+    const Position right = portals[i].second;
+    // try to narrow the funnel from the right side
+    if (triarea2(portalApex, portalRight, right) <= 0.f)
+    {
+      if (portalApex == portalRight || triarea2(portalApex, portalLeft, right) > 0.f)
+      {
+        portalRight = right;
+        rightIdx = i;
+      }
+      else
+      {
+        // right crossed over left, left becomes a corner of the path
+        res.push_back(portalLeft);
+        portalApex = portalLeft;
+        apexIdx = leftIdx;
+        portalRight = portalApex;
+        rightIdx = apexIdx;
+        i = apexIdx;
+        continue;
+      }
+    }
+    // and from the left side
+    if (triarea2(portalApex, portalLeft, left) >= 0.f)
+    {
+      if (portalApex == portalLeft || triarea2(portalApex, portalRight, left) < 0.f)
+      {
+        portalLeft = left;
+        leftIdx = i;
+      }
+      else
+      {
+        res.push_back(portalRight);
+        portalApex = portalRight;
+        apexIdx = rightIdx;
+        portalLeft = portalApex;
+        leftIdx = apexIdx;
+        i = apexIdx;
+        continue;
+      }
+    }
+  }
+  if (res.back() != portals.back().first)
+    res.push_back(portals.back().first);
+  return res;
+}
+
+std::vector<Position> find_nav_mesh_path(const DungeonNavMesh &nm, Position from, Position to)
+{
+  const size_t fromRect = find_rect(nm, from);
+  const size_t toRect = find_rect(nm, to);
+  if (fromRect == invalid_rect || toRect == invalid_rect)
+    return {};
+
+  const std::vector<size_t> rectPath = find_rect_path_a_star(nm, fromRect, toRect, from, to);
+  if (rectPath.empty())
+    return {};
+
+  std::vector<std::pair<Position, Position>> portals = {{from, from}};
+  for (size_t i = 0; i + 1 < rectPath.size(); ++i)
+  {
+    const NavRect &cur = nm.rects[rectPath[i]];
+    const NavRect &next = nm.rects[rectPath[i + 1]];
+    auto connIt = std::find_if(cur.conns.begin(), cur.conns.end(),
+                               [&](const NavRectConnection &conn) { return conn.rectIdx == rectPath[i + 1]; });
+    // portalFrom is always top/left end of the edge, orient it by the direction we're crossing it
+    const bool forward = next.start.x > cur.end.x || next.start.y > cur.end.y;
+    const bool vertical = connIt->portalFrom.x == connIt->portalTo.x;
+    if (forward != vertical)
+      portals.push_back({connIt->portalFrom, connIt->portalTo});
+    else
+      portals.push_back({connIt->portalTo, connIt->portalFrom});
+  }
+  portals.push_back({to, to});
+  return string_pull(portals);
+}
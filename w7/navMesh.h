@@ -0,0 +1,39 @@
+#pragma once
+#include <flecs.h>
+#include <vector>
+#include "ecsTypes.h"
+#include "math.h"
+
+// all coordinates here are in tiles, tile (x, y) covers [x, x + 1) x [y, y + 1)
+struct NavRectConnection
+{
+  size_t rectIdx;
+  // shared edge between two rects
+  Position portalFrom;
+  Position portalTo;
+};
+
+struct NavRect
+{
+  IVec2 start; // inclusive
+  IVec2 end; // inclusive
+  std::vector<NavRectConnection> conns;
+};
+
+struct DungeonNavMesh
+{
+  std::vector<NavRect> rects;
+  std::vector<size_t> tileRects; // rect index for each tile, size_t(-1) for walls
+  size_t width;
+  size_t height;
+};
+
+struct NavMeshPath
+{
+  std::vector<Position> points;
+};
+
+DungeonNavMesh build_nav_mesh(const DungeonData &dd);
+void prebuild_nav_mesh(flecs::world &ecs);
+
+std::vector<Position> find_nav_mesh_path(const DungeonNavMesh &nm, Position from, Position to);
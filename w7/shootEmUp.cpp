@@ -6,6 +6,7 @@
 #include "dungeonGen.h"
 #include "dungeonUtils.h"
 #include "pathfinder.h"
+#include "navMesh.h"
 
 constexpr float tile_size = 64.f;
 
@@ -138,6 +139,24 @@ static void register_roguelike_systems(flecs::world &ecs)
       });
     });
 
+  ecs.system<const DungeonNavMesh>()
+    .each([&](const DungeonNavMesh &nm)
+    {
+      for (const NavRect &rect : nm.rects)
+        DrawRectangleLinesEx(Rectangle{float(rect.start.x) * tile_size, float(rect.start.y) * tile_size,
+                                       float(rect.end.x - rect.start.x + 1) * tile_size,
+                                       float(rect.end.y - rect.start.y + 1) * tile_size}, 2.f, GetColor(0x00ffff40));
+    });
+
+  ecs.system<const NavMeshPath>()
+    .each([&](const NavMeshPath &path)
+    {
+      for (size_t i = 0; i + 1 < path.points.size(); ++i)
+        DrawLineEx(Vector2{path.points[i].x * tile_size, path.points[i].y * tile_size},
+                   Vector2{path.points[i + 1].x * tile_size, path.points[i + 1].y * tile_size},
+                   2.f, GetColor(0xffff00ff));
+    });
+
   static auto tilePosToVector = [](const TilePosition &tilePos) {
     return Vector2{
         tilePos.x * tile_size + tile_size / 2,
@@ -201,6 +220,7 @@ void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
         tileEntity.add<TextureSource>(floorTex);
     }
   prebuild_map(ecs);
+  prebuild_nav_mesh(ecs);
 }
 
 void process_game(flecs::world &ecs)
@@ -211,6 +231,7 @@ void process_game(flecs::world &ecs)
       .build();
 
   static auto pathfindQuery = ecs.query<const Position, const PathfindTarget>();
+  static auto navMeshQuery = ecs.query<const DungeonNavMesh>();
 
   static auto posToTilePos = [](const auto& pos, float offset = 0) {
     return TilePosition{static_cast<int>((pos.x + offset) / tile_size),
@@ -230,8 +251,15 @@ void process_game(flecs::world &ecs)
 
   if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT) || IsKeyPressed(KEY_SPACE)) {
     reset_path_visualizations(ecs);
-    pathfindQuery.each([&](flecs::entity e, const Position& pos, const PathfindTarget& target) {
-      find_and_visualize_path(ecs, posToTilePos(pos, tile_size / 2), target.pos);
+    ecs.defer([&] {
+      pathfindQuery.each([&](flecs::entity e, const Position& pos, const PathfindTarget& target) {
+        find_and_visualize_path(ecs, posToTilePos(pos, tile_size / 2), target.pos);
+        navMeshQuery.each([&](const DungeonNavMesh &nm) {
+          const Position from = (pos + Position{tile_size / 2, tile_size / 2}) * (1.f / tile_size);
+          const Position to{float(target.pos.x) + 0.5f, float(target.pos.y) + 0.5f};
+          e.set(NavMeshPath{find_nav_mesh_path(nm, from, to)});
+        });
+      });
     });
   }
 }